@@ -0,0 +1,102 @@
+// bench-assemble: assembler throughput in source lines per second. Times
+// loadProgram() on a generated program (or a given source file), best of
+// several runs; see the README for the build command.
+#include "riscv_core.h"
+
+#include <random>
+
+static const char USAGE[] =
+    "usage: bench-assemble [options] [program.s]\n"
+    "  program.s        source to assemble (default: a generated program)\n"
+    "  --blocks=N       generated program size in 6-instruction blocks (default 40000)\n"
+    "  --runs=N         timed runs; the best is reported (default 5)\n";
+
+// Labelled blocks of ALU, memory, LI and branch statements with comments,
+// followed by a .data table that refers back to the labels; about 7 lines
+// per block
+static string generateProgram(int blocks)
+{
+    static const char *const regs[] = {"a0", "a1", "t0", "t1", "s0", "x5", "x12", "sp"};
+    mt19937 rng(1);
+    auto reg = [&]
+    { return regs[rng() % size(regs)]; };
+    auto range = [&](int lo, int hi)
+    { return lo + (int)(rng() % (uint32_t)(hi - lo + 1)); };
+
+    ostringstream out;
+    for (int i = 0; i < blocks; ++i)
+    {
+        out << "blk" << i << ":   # block " << i << "\n"
+            << "    addi " << reg() << ", " << reg() << ", " << range(-2048, 2047) << "\n"
+            << "    lw   t0, " << range(-512, 511) * 4 << "(sp)\n"
+            << "    li   a1, 0x" << hex << (rng() & 0x7FFFFFFF) << dec << "   # big const\n"
+            << "    add  " << reg() << ", " << reg() << ", " << reg() << "\n"
+            << "    beq  a0, a1, blk" << i << "\n"
+            << "    sw   a1, 8(sp)\n";
+    }
+    out << "    ecall\n.data\n";
+    for (int i = 0; i < blocks / 8; ++i)
+        out << "d" << i << ": .word " << i << ", " << i * 3 << ", blk" << i << "\n";
+    return out.str();
+}
+
+int main(int argc, char **argv)
+{
+    int blocks = 40000, runs = 5;
+    string path;
+    for (int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        if (arg.substr(0, 9) == "--blocks=")
+            blocks = atoi(argv[i] + 9);
+        else if (arg.substr(0, 7) == "--runs=")
+            runs = atoi(argv[i] + 7);
+        else if (arg[0] != '-' && path.empty())
+            path = arg;
+        else
+        {
+            cerr << USAGE;
+            return 2;
+        }
+    }
+    if (blocks <= 0 || runs <= 0)
+    {
+        cerr << USAGE;
+        return 2;
+    }
+
+    string source;
+    if (path.empty())
+        source = generateProgram(blocks);
+    else
+    {
+        ifstream in(path, ios::binary);
+        if (!in)
+        {
+            cerr << "[Error] Cannot open " << path << "\n";
+            return 1;
+        }
+        source.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    size_t lines = count(source.begin(), source.end(), '\n');
+
+    // The load summary is printed once, from the last run
+    double best = numeric_limits<double>::max();
+    for (int run = 0; run < runs; ++run)
+    {
+        SimpleRISCV cpu;
+        if (run + 1 < runs)
+            cerr.setstate(ios::failbit);
+        auto start = chrono::steady_clock::now();
+        cpu.loadProgram(source);
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        cerr.clear();
+    }
+
+    cout << "lines         " << lines << " (" << source.size() / 1024 << " KiB)\n"
+         << fixed << setprecision(3)
+         << "best time     " << best * 1e3 << " ms (of " << runs << ")\n"
+         << setprecision(2)
+         << "rate          " << lines / best / 1e6 << " M lines/s\n";
+    return 0;
+}
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Builds the web module (riscv.js / riscv.wasm) with Emscripten. Rebuild and
+# commit both files whenever main.cpp's bindings or the core change, so the
+# page and riscv_run_node.js always match the sources.
+#   ./build.sh            RV32I
+#   ./build.sh 64         RV64I
+set -e
+cd "$(dirname "$0")"
+xlen=${1:-32}
+emcc main.cpp -std=c++20 -O3 -DRISCV_XLEN="$xlen" -lembind \
+     -sMODULARIZE -sEXPORT_NAME=createRiscvModule \
+     -sALLOW_MEMORY_GROWTH -sEXPORTED_RUNTIME_METHODS=HEAPU8 \
+     -pthread -sPTHREAD_POOL_SIZE=1 -o riscv.js
@@ -1,14 +1,31 @@
 // --- Global Setup ---
 const createRiscvModule = window.createRiscvModule;
 let Module = null;
+
+// Bindings the page calls; a riscv.js / riscv.wasm built from older sources
+// lacks some of them and is reported instead of failing on first use
+const REQUIRED_BINDINGS = [
+  "jsLoadProgram", "jsLoadProgramLazy", "jsUpdateLines", "jsProgramCacheKey",
+  "jsLoadCachedProgram", "jsSaveProgramCache", "jsProgramCacheData", "jsLoadElf",
+  "jsStep", "jsStartRun", "jsRunFor", "jsStopRun", "jsRunControl", "jsConsumeDelta",
+  "jsDrainEvents", "jsEventsPtr", "jsFormatEvents", "jsTextData", "jsSetProfiling",
+  "jsProfileLines", "jsProfileData", "jsProfileFunctions", "jsInstructionMix",
+  "jsMixData", "jsMixNames", "jsSetPipeline", "jsPipelineReport", "getCpuInstance",
+  "jsXlen",
+];
 let memView = null;  
-let prevRegs = Array(32).fill(0);
-let prevMem = [];
+let regsView = null; // x0..x31 then pc, mapped from the core's register file
+let highlightedRegs = 0;   // register cells marked "changed" by the last refresh
+let highlightedRanges = []; // memory words marked likewise, as [firstWord, count]
 let lastInspectedAddr = null;
 let prevMemBytes = new Map();
 let stopRequested = false;
 let isRunning = false;
 let currentRunId = 0;
+let runCtl = null; // Int32Array over the background runner's control words
+let loadedSource = null; // program text the core last assembled
+let profiling = false;   // per-PC execution counts (heat gutter) enabled
+let pipelineTiming = false; // 5-stage pipeline cycle estimate enabled
 
 const ABI_REG_NAMES = [
   "zero", "ra", "sp", "gp", "tp",  // 0–4
@@ -20,60 +37,239 @@ const ABI_REG_NAMES = [
 let showAbiNames = false; // toggle flag
 
 
+// --- Virtualized lists ---
+// A scrolling list that only has DOM rows for what is in view: a spacer as
+// tall as all rows gives the scrollbar its range, and a small pool of
+// fixed-height rows is moved over the visible part and refilled through
+// `renderRow(el, index)`. Past MAX_SCROLL_PX the spacer stops growing and
+// the scroll position maps to rows proportionally. With `followEnd` the
+// list stays scrolled to the bottom while the user leaves it there.
+const MAX_SCROLL_PX = 1 << 23;
+
+function createVirtualList(container, rowHeight, renderRow, followEnd = false) {
+  const spacer = document.createElement("div");
+  spacer.className = "virtual-spacer";
+  const win = document.createElement("div");
+  win.className = "virtual-window";
+  spacer.appendChild(win);
+  container.classList.add("virtual-list");
+  container.replaceChildren(spacer);
+
+  let count = 0;
+  let pinned = followEnd;
+  let queued = false;
+  let lastScrollTop = 0;
+
+  const atEnd = () => container.scrollTop + container.clientHeight >= container.scrollHeight - rowHeight;
+
+  function render() {
+    queued = false;
+    if (pinned) container.scrollTop = container.scrollHeight;
+    lastScrollTop = container.scrollTop;
+
+    const visible = Math.min(count, Math.ceil(container.clientHeight / rowHeight) + 1);
+    const height = spacer.offsetHeight;
+    let first, top;
+    if (height < count * rowHeight) {
+      const range = Math.max(1, height - container.clientHeight);
+      first = Math.min(count - visible, Math.floor((lastScrollTop / range) * (count - visible + 1)));
+      top = lastScrollTop;
+    } else {
+      first = Math.min(count - visible, Math.floor(lastScrollTop / rowHeight));
+      top = first * rowHeight;
+    }
+
+    while (win.children.length < visible) {
+      const row = document.createElement("div");
+      row.style.height = row.style.lineHeight = `${rowHeight}px`;
+      win.appendChild(row);
+    }
+    while (win.children.length > visible) win.lastChild.remove();
+    win.style.transform = `translateY(${top}px)`;
+    for (let i = 0; i < visible; i++) renderRow(win.children[i], first + i);
+  }
+
+  // Coalesces any number of updates into one render per frame
+  function refresh() {
+    if (queued) return;
+    queued = true;
+    requestAnimationFrame(render);
+  }
+
+  container.addEventListener("scroll", () => {
+    if (container.scrollTop === lastScrollTop) return; // our own render
+    pinned = followEnd && atEnd();
+    refresh();
+  }, { passive: true });
+  new ResizeObserver(refresh).observe(container);
+
+  return {
+    setCount(n) {
+      count = n;
+      spacer.style.height = `${Math.min(n * rowHeight, MAX_SCROLL_PX)}px`;
+      refresh();
+    },
+    refresh,
+    scrollToIndex(i) {
+      const height = Math.min(count * rowHeight, MAX_SCROLL_PX);
+      container.scrollTop = height < count * rowHeight
+        ? (i / Math.max(1, count - 1)) * (height - container.clientHeight)
+        : i * rowHeight;
+      pinned = followEnd && atEnd();
+      refresh();
+    },
+  };
+}
+
 // --- Console Helpers ---
+// Lines live in a backing buffer; only the rows in view are in the DOM.
+// The oldest lines are dropped past CONSOLE_MAX_LINES.
+const CONSOLE_ROW_HEIGHT = 18;
+const CONSOLE_MAX_LINES = 200000;
+let consoleLines = []; // { text, type }
+let consoleList = null;
+
+function consoleView() {
+  if (!consoleList) {
+    consoleList = createVirtualList(document.getElementById("consoleOutput"), CONSOLE_ROW_HEIGHT, (row, i) => {
+      const line = consoleLines[i];
+      row.textContent = line.text;
+      row.className = line.type === "error" ? "virtual-row console-error" : "virtual-row console-info";
+    }, true);
+  }
+  return consoleList;
+}
+
 function addConsoleLine(text, type = "info") {
-  const consoleDiv = document.getElementById("consoleOutput");
-  const line = document.createElement("div");
-  line.textContent = text;
-  line.className = type === "error" ? "console-error" : "console-info";
-  consoleDiv.appendChild(line);
-  consoleDiv.scrollTop = consoleDiv.scrollHeight;
-
-  // Live instruction display
-  if (text.startsWith("[Exec]")) {
-    const currInstr = document.getElementById("currInstr");
-    currInstr.textContent = "Current Instruction: " + text.replace("[Exec]", "").trim();
+  consoleLines.push({ text, type });
+  if (consoleLines.length > CONSOLE_MAX_LINES) {
+    consoleLines.splice(0, CONSOLE_MAX_LINES / 10);
   }
+  consoleView().setCount(consoleLines.length);
+}
+
+// Text the core wrote at jsTextData(), `length` UTF-8 bytes. TextDecoder
+// rejects views of a shared heap (-pthread builds), so those are copied.
+const textDecoder = new TextDecoder();
+
+function coreText(length) {
+  const bytes = new Uint8Array(Module.HEAPU8.buffer, Module.jsTextData(), length);
+  return textDecoder.decode(bytes.buffer instanceof ArrayBuffer ? bytes : bytes.slice());
+}
 
-  if (text.includes("[Warning]")) {
-    flashMemoryWarning();
+// Execution events are 32-byte records (Event in riscv_core.h); only the
+// kind byte is read here, the text comes from jsFormatEvents in one batch
+const EVENT_SIZE = 32;
+const EVENT_EXEC = 0, EVENT_FAULT = 2, EVENT_MISALIGNED = 3;
+const EXEC_PREFIX = "[Exec] ";
+
+function drainEvents() {
+  const count = Module.jsDrainEvents();
+  if (count === 0) return;
+  const base = Module.jsEventsPtr();
+  const lines = coreText(Module.jsFormatEvents(0, count)).split("\n");
+  let warned = false;
+  for (let i = 0; i < count; i++) {
+    const kind = Module.HEAPU8[base + i * EVENT_SIZE];
+    const text = lines[i];
+    addConsoleLine(text, "error");
+    if (kind === EVENT_EXEC) {
+      document.getElementById("currInstr").textContent =
+        "Current Instruction: " + text.slice(EXEC_PREFIX.length);
+    } else if (kind === EVENT_FAULT || kind === EVENT_MISALIGNED) {
+      warned = true;
+    }
   }
+  if (warned) flashMemoryWarning();
 }
 
 function clearConsole() {
-  document.getElementById("consoleOutput").innerHTML = "";
+  consoleLines = [];
+  consoleView().setCount(0);
 }
 
 // --- UI Setup ---
 function setupUI() {
   const getProgram = () => document.getElementById("programInput").value;
 
-  document.getElementById("loadBtn").onclick = () => {
+  document.getElementById("loadBtn").onclick = async () => {
     stopRequested = true;
     currentRunId++;
     isRunning = false;
 
     clearConsole();
     const src = getProgram();
-    Module.jsLoadProgram(src);
+    if (loadedSource === null) {
+      await loadProgramCached(src);
+    } else {
+      // Only the edited lines are re-assembled
+      const edit = diffLines(loadedSource, src);
+      Module.jsUpdateLines(edit.first, edit.removed, edit.text);
+    }
+    loadedSource = src;
 
     try { rebindMemView(); } catch (e) { console.error("rebind after load failed:", e); }
 
     addConsoleLine("📜 Program loaded.", "info");
-    prevRegs = Array(32).fill(0);
+    refreshUI(true);
+  };
+
+  // --- ELF executables (statically linked, e.g. from riscv32-unknown-elf-gcc) ---
+  document.getElementById("elfBtn").onclick = () => document.getElementById("elfInput").click();
+  document.getElementById("elfInput").onchange = async (e) => {
+    const file = e.target.files[0];
+    e.target.value = ""; // allow re-selecting the same file
+    if (!file) return;
+
+    stopRequested = true;
+    currentRunId++;
+    isRunning = false;
+
+    clearConsole();
+    const bytes = new Uint8Array(await file.arrayBuffer());
+    loadedSource = null;
+    if (!Module.jsLoadElf(bytes)) {
+      addConsoleLine(`⚠ Failed to load ELF: ${file.name}`, "error");
+      return;
+    }
+
+    try { rebindMemView(); } catch (err) { console.error("rebind after ELF load failed:", err); }
+
+    addConsoleLine(`📦 ELF loaded: ${file.name}`, "info");
     refreshUI(true);
   };
 
   document.getElementById("stepBtn").onclick = () => {
+    if (isRunning) return;
     const ok = Module.jsStep();
     refreshUI();
     if (!ok) addConsoleLine("🛑 Program halted.", "error");
   };
 
-  document.getElementById("runBtn").onclick = runSlow;
+  document.getElementById("runBtn").onclick = runProgram;
+
+  document.getElementById("profileBtn").onclick = () => {
+    if (isRunning) return;
+    profiling = !profiling;
+    Module.jsSetProfiling(profiling);
+    document.getElementById("profileBtn").textContent = profiling ? "Profile: on" : "Profile";
+    document.getElementById("heatGutter").hidden = !profiling;
+    addConsoleLine(profiling ? "🔥 Profiling on: counts reset." : "Profiling off.", "info");
+    updateHeatGutter();
+  };
+  setupHeatGutter();
+
+  document.getElementById("pipelineBtn").onclick = () => {
+    if (isRunning) return;
+    pipelineTiming = !pipelineTiming;
+    Module.jsSetPipeline(pipelineTiming, "");
+    document.getElementById("pipelineBtn").textContent = pipelineTiming ? "Pipeline: on" : "Pipeline";
+    addConsoleLine(pipelineTiming ? "⏱️ Pipeline timing on: cycles reset." : "Pipeline timing off.", "info");
+  };
 
   document.getElementById("stopBtn").onclick = () => {
     stopRequested = true;
+    if (isRunning) Atomics.store(runControl(), RUN_STOP, 1);
     addConsoleLine("⏹️ Stop requested.", "info");
       const ta = document.getElementById("programInput");
     // Ensure the selection highlight remains visible
@@ -82,23 +278,18 @@ function setupUI() {
 
   document.getElementById("resetBtn").onclick = async () => {
     stopRequested = true;
-    currentRunId++;           // cancels any in-flight runSlow loop
+    currentRunId++;           // cancels any in-flight runProgram loop
     isRunning = false;
     await Promise.resolve(); 
 
-
     clearConsole();
-    addConsoleLine("🔄 Reloading RISC-V runtime...", "info");
+    addConsoleLine("🔄 Resetting the CPU...", "info");
 
-    // Recreate a fresh module to restore console streams
-    Module = await createRiscvModule({
-      print: (msg) => addConsoleLine(msg, "info"),
-      printErr: (msg) => addConsoleLine(msg, "error"),
-    });
-
-    // --- Reload program ---
+    // Reloading resets the core in place (stopping its runner thread); a
+    // new module would leave the old one's worker and heap behind
     const src = document.getElementById("programInput").value;
-    Module.jsLoadProgram(src);
+    await loadProgramCached(src);
+    loadedSource = src;
 
     // --- Setup shared memory view ---
     try {
@@ -107,20 +298,11 @@ function setupUI() {
       console.error("Memory view setup failed during reset:", e);
     }
 
-
     addConsoleLine("🔁 CPU Reset & Program Reloaded.", "info");
 
     // --- Reset register tracking properly ---
-    prevRegs = Array(32).fill(0);
     refreshUI(true);
 
-    // After first UI refresh, sync current register snapshot (so SP/GP won't flash)
-    const stateStr = Module.jsDumpState();
-    const lines = stateStr.split("\n");
-    for (const line of lines) {
-      const matches = [...line.matchAll(/x(\d+)=\s*(-?\d+)/g)];
-      for (const m of matches) prevRegs[parseInt(m[1])] = parseInt(m[2]);
-    }
     document.getElementById("currInstr").textContent = "Current Instruction: (none)";
   };
 
@@ -146,6 +328,7 @@ function setupUI() {
     const localAddr = aligned; // offset within emulator memory (0..4095)
     const dv = new DataView(memView.buffer, memView.byteOffset + localAddr, 4);
     const val = dv.getUint32(0, true); // little-endian
+    memList.scrollToIndex(aligned >> 2);
 
     addConsoleLine( 
       `🔍 Memory[0x${aligned.toString(16)} (${aligned})] = ${val} (requested 0x${addr.toString(16)})`,
@@ -169,6 +352,76 @@ function setupUI() {
   buildMemTable();
 }
 
+// --- Compiled-program cache (IndexedDB, keyed by source hash) ---
+let programCacheDb = null;
+
+function openProgramCache() {
+  if (!programCacheDb) {
+    programCacheDb = new Promise((resolve) => {
+      if (!window.indexedDB) return resolve(null);
+      const req = indexedDB.open("riscv-program-cache", 1);
+      req.onupgradeneeded = () => req.result.createObjectStore("programs");
+      req.onsuccess = () => resolve(req.result);
+      req.onerror = () => resolve(null); // e.g. private browsing: run uncached
+    });
+  }
+  return programCacheDb;
+}
+
+async function programCacheGet(key) {
+  const db = await openProgramCache();
+  if (!db) return null;
+  return new Promise((resolve) => {
+    const req = db.transaction("programs").objectStore("programs").get(key);
+    req.onsuccess = () => resolve(req.result || null);
+    req.onerror = () => resolve(null);
+  });
+}
+
+async function programCachePut(key, bytes) {
+  const db = await openProgramCache();
+  if (db) db.transaction("programs", "readwrite").objectStore("programs").put(bytes, key);
+}
+
+// Sources longer than this are assembled lazily (not cached)
+const LAZY_ASSEMBLY_LINES = 50000;
+
+// Full load; a program assembled before is restored without parsing
+async function loadProgramCached(src) {
+  const key = Module.jsProgramCacheKey(src);
+  const cached = await programCacheGet(key);
+  if (cached && Module.jsLoadCachedProgram(src, key, cached)) return;
+
+  if (src.split("\n").length > LAZY_ASSEMBLY_LINES) {
+    Module.jsLoadProgramLazy(src);
+    return;
+  }
+  Module.jsLoadProgram(src);
+  const size = Module.jsSaveProgramCache(key);
+  if (size) {
+    const ptr = Module.jsProgramCacheData();
+    programCachePut(key, Module.HEAPU8.slice(ptr, ptr + size));
+  }
+}
+
+// Smallest line range that differs between two program texts:
+// lines [first, first + removed) of `before` became `text` (one "\n" per line)
+function diffLines(before, after) {
+  const a = before.split("\n");
+  const b = after.split("\n");
+  let first = 0;
+  while (first < a.length && first < b.length && a[first] === b[first]) first++;
+  let tail = 0;
+  while (tail < a.length - first && tail < b.length - first &&
+         a[a.length - 1 - tail] === b[b.length - 1 - tail]) tail++;
+  const added = b.slice(first, b.length - tail);
+  return {
+    first,
+    removed: a.length - first - tail,
+    text: added.map(line => line + "\n").join(""),
+  };
+}
+
 // --- Memory Management
 function rebindMemView() {
   const cpu = Module.getCpuInstance();
@@ -186,9 +439,21 @@ function rebindMemView() {
   }
 
   memView = new Uint8Array(Module.HEAPU8.buffer, basePtr, memSize);
+  if (memList) memList.setCount(memSize >> 2);
   console.log(`Shared memory view established: ${memSize} bytes @ 0x${basePtr.toString(16)}`);
 }
 
+// Register file view: Int32Array on RV32 builds, BigInt64Array on RV64.
+// Rebound when the wasm heap is replaced (growth detaches the old buffer).
+function regsState() {
+  if (!regsView || regsView.buffer !== Module.HEAPU8.buffer) {
+    const ptr = Module.getCpuInstance().getRegsPtr();
+    const View = Module.jsXlen() === 64 ? BigInt64Array : Int32Array;
+    regsView = new View(Module.HEAPU8.buffer, ptr, 33);
+  }
+  return regsView;
+}
+
 function showMemoryNeighborhood(targetAddr) {
   if (!memView) {
     try { rebindMemView(); } catch (e) {
@@ -272,83 +537,128 @@ function showMemoryNeighborhood(targetAddr) {
 }
 
 // --- Run Loop ---
-async function runSlow() {
-  // start a new run
-  stopRequested = false;
-  isRunning = true;
-  const myRunId = ++currentRunId;
+// Background runner control words and states (RunWord / RunState in main.cpp)
+const RUN_STOP = 0, RUN_STATE = 1;
+const RUN_RUNNING = 1, RUN_HALTED = 2, RUN_STOPPED = 3;
 
-  addConsoleLine("▶ Running program...", "info");
-
-  for (let i = 0; i < 1000; i++) {
-    // abort if another run started or a stop/reset happened
-    if (stopRequested || myRunId !== currentRunId) {
-      addConsoleLine("⏹️ Execution stopped.", "error");
-      break;
-    }
+function runControl() {
+  if (!runCtl || runCtl.buffer !== Module.HEAPU8.buffer) {
+    runCtl = new Int32Array(Module.HEAPU8.buffer, Module.jsRunControl(), 2);
+  }
+  return runCtl;
+}
 
-    if (!Module.jsStep()) {
-      addConsoleLine("🛑 Program halted.", "error");
-      break;
-    }
+// Run time per animation frame when the core runs on the main thread;
+// leaves the rest of a 60 Hz frame for input and painting
+const FRAME_BUDGET_US = 8000;
+
+// Runs on the calling thread in per-frame slices, yielding between them
+async function runOnMainThread(myRunId) {
+  for (;;) {
+    if (stopRequested) return RUN_STOPPED;
+    if (Module.jsRunFor(FRAME_BUDGET_US, 0) !== RUN_RUNNING) return RUN_HALTED;
+    await new Promise(requestAnimationFrame);
+    if (myRunId !== currentRunId) return null;
+    refreshUI();
+  }
+}
 
+// The program runs at full speed on the core's worker thread; this loop
+// only samples its state once per frame until the run ends
+async function runInBackground(myRunId) {
+  Module.jsStartRun(0);
+  while (Atomics.load(runControl(), RUN_STATE) === RUN_RUNNING) {
+    await new Promise(requestAnimationFrame);
+    if (myRunId !== currentRunId) return null;
     refreshUI();
-    await new Promise(r => setTimeout(r, 200));
   }
+  Module.jsStopRun(); // joins the finished runner
+  return Atomics.load(runControl(), RUN_STATE);
+}
+
+async function runProgram() {
+  if (isRunning) return;
+  stopRequested = false;
+  isRunning = true;
+  const myRunId = ++currentRunId;
 
-  if (myRunId === currentRunId && !stopRequested) {
+  addConsoleLine("▶ Running program...", "info");
+  // A shared heap means a -pthread build on a cross-origin isolated page
+  const threaded = typeof SharedArrayBuffer !== "undefined" &&
+                   Module.HEAPU8.buffer instanceof SharedArrayBuffer;
+  const state = await (threaded ? runInBackground : runOnMainThread)(myRunId);
+  if (state === null) return; // a load or reset took over
+  isRunning = false;
+  refreshUI(); // shows the run's events before the summary
+
+  if (state === RUN_STOPPED) {
+    addConsoleLine("⏹️ Execution stopped.", "error");
+  } else {
+    if (state === RUN_HALTED) addConsoleLine("🛑 Program halted.", "error");
     addConsoleLine("🏁 Run complete.", "info");
   }
-  isRunning = false;
+  if (profiling) {
+    printHotFunctions();
+    printInstructionMix();
+  }
+  if (pipelineTiming) printPipelineReport();
 }
 
 // ------------------ UI Refresh ------------------
-function refreshUI(reset = false) {
-  const stateStr = Module.jsDumpState();
-  const lines = stateStr.split("\n");
+// Changes since the last call, from the core's delta record:
+// { full, regMask, ranges: [[firstWord, wordCount], ...] }
+function consumeDelta() {
+  const ptr = Module.jsConsumeDelta();
+  const head = new Uint32Array(Module.HEAPU8.buffer, ptr, 3);
+  const body = new Uint32Array(Module.HEAPU8.buffer, ptr + 12, 2 * head[2]);
+  const ranges = [];
+  for (let i = 0; i < body.length; i += 2) ranges.push([body[i], body[i + 1]]);
+  return { full: (head[0] & 1) !== 0, regMask: head[1], ranges };
+}
 
+// Repaints only what the delta reports, plus cells whose highlight must go;
+// `reset` (and every refresh during a background run) repaints everything
+// without highlights
+function refreshUI(reset = false) {
+  const regs = regsState();
+  // While the runner owns the core, sample without touching its delta
+  // or events
+  const delta = isRunning ? { full: true, regMask: 0, ranges: [] } : consumeDelta();
+  if (!isRunning) drainEvents();
+  const full = reset || delta.full;
 
   // PC
-  const pcMatch = lines[0].match(/PC=0x([0-9a-fA-F]+)/);  
-  if (pcMatch) {
-    const pcVal = parseInt(pcMatch[1], 16);
-    document.getElementById("pcDisplay").textContent = `PC: 0x${pcMatch[1]}`;
-    highlightCurrentLine(pcVal);
-  }
+  const pc = regs[32];
+  const pcHex = typeof pc === "bigint" ? BigInt.asUintN(64, pc).toString(16) : (pc >>> 0).toString(16);
+  document.getElementById("pcDisplay").textContent = `PC: 0x${pcHex}`;
+  highlightCurrentLine(Number(pc));
 
   // Registers
-  const regs = [];
-  for (const line of lines) {
-    const matches = [...line.matchAll(/x(\d+)=\s*(-?\d+)/g)];
-    for (const m of matches) regs[parseInt(m[1])] = parseInt(m[2]);
-  }
-
   const regTable = document.getElementById("regTable");
+  const regMask = full ? 0 : delta.regMask;
   for (let i = 0; i < 32; i++) {
+    const changed = (regMask >>> i) & 1;
+    if (!full && !changed && !((highlightedRegs >>> i) & 1)) continue;
     const cell = regTable.rows[Math.floor(i / 4)].cells[i % 4];
-    const changed = !reset && regs[i] !== prevRegs[i];
     const label = showAbiNames ? ABI_REG_NAMES[i] : `x${i.toString().padStart(2, "0")}`;
     cell.textContent = `${label}: ${regs[i]}`;
     cell.className = changed ? "changed" : "";
-    prevRegs[i] = regs[i];
   }
+  highlightedRegs = regMask;
 
   // Memory
-  const memLine = lines.find(l => l.includes("Memory[words 0..63]"));
-  if (memLine) {
-    // extract pairs like "123(0x7b)"
-    const pairs = memLine.split(":")[1].trim().split(/\s+/);
-    const values = pairs.map(p => {
-      const m = p.match(/(-?\d+)\((0x[0-9a-fA-F]+)\)/);
-      if (m) return { dec: parseInt(m[1]), hex: m[2] };
-      return { dec: parseInt(p), hex: "0x0" };
-    });
-    updateMemTable(values, reset);
+  if (!memView || memView.buffer !== Module.HEAPU8.buffer) {
+    try { rebindMemView(); } catch (e) { return; }
   }
+  highlightedRanges = full ? [] : delta.ranges;
+  memList.refresh();
 
   if (lastInspectedAddr !== null) {
     showMemoryNeighborhood(lastInspectedAddr);
   }
+
+  // Counts are read only while the runner is idle
+  if (profiling && !isRunning) updateHeatGutter();
 }
 
 function buildRegTable() {
@@ -365,59 +675,133 @@ function buildRegTable() {
   }
 }
 
-// Memory Table: scrollable, hex + decimal display
+// Memory Table: every word of guest memory, hex + decimal, as a
+// virtualized list; rows are read straight from memView when shown
+const MEM_ROW_HEIGHT = 25;
+let memList = null;
+
 function buildMemTable() {
-  const tbl = document.getElementById("memTable");
-  tbl.innerHTML = "";
-  const header = tbl.insertRow();
-  header.innerHTML = "<th>Address (Hex / Dec)</th><th>Value (Dec / Hex)</th>";
+  memList = createVirtualList(document.getElementById("memTable"), MEM_ROW_HEIGHT, renderMemRow);
+  memList.setCount(memView ? memView.length >> 2 : 0);
+}
 
-  const ROWS = 64; // first 64 words = 256 bytes
-  for (let i = 0; i < ROWS; i++) {
-    const row = tbl.insertRow();
-    const addrCell = row.insertCell();
-    const valCell = row.insertCell();
-    const addr = i * 4; // word-aligned addresses
-    addrCell.textContent = `0x${addr.toString(16).padStart(3, "0")} (${addr})`;
-    valCell.textContent = "0 (0x0)";
+// Whether word `w` lies in one of the sorted, disjoint [first, count] ranges
+function inRanges(ranges, w) {
+  let lo = 0, hi = ranges.length;
+  while (lo < hi) {
+    const mid = (lo + hi) >> 1;
+    if (ranges[mid][0] <= w) lo = mid + 1;
+    else hi = mid;
   }
+  return lo > 0 && w < ranges[lo - 1][0] + ranges[lo - 1][1];
 }
 
+// Green highlight + smooth transition for words the last refresh changed
+function renderMemRow(row, w) {
+  if (!row.firstChild) row.append(document.createElement("span"), document.createElement("span"));
+  row.className = w % 2 === 0 ? "virtual-row mem-row striped" : "virtual-row mem-row";
+  const [addrCell, valCell] = row.children;
+  const addr = w * 4;
+  addrCell.textContent = `0x${addr.toString(16).padStart(3, "0")} (${addr})`;
 
-// Green highlight + smooth transition
-function updateMemTable(values, reset) {
-  const tbl = document.getElementById("memTable");
-  const totalRows = tbl.rows.length - 1; // minus header
-  const limit = Math.min(values.length, totalRows);
+  if (memView.buffer !== Module.HEAPU8.buffer) rebindMemView();
+  if (addr + 4 > memView.length) {
+    valCell.textContent = "—";
+  } else {
+    const val = new DataView(memView.buffer, memView.byteOffset + addr, 4).getUint32(0, true);
+    valCell.textContent = `${val} (0x${val.toString(16)})`;
+  }
+  valCell.className = inRanges(highlightedRanges, w) ? "changed" : "";
+}
 
-  if (reset || prevMem.length !== values.length) {
-    prevMem = values.map(v => v.dec);
-    for (let i = 1; i <= totalRows; i++) {
-      const row = tbl.rows[i];
-      if (i <= limit) {
-        const v = values[i - 1];
-        row.cells[1].textContent = `${v.dec} (${v.hex})`;
-      } else {
-        row.cells[1].textContent = "—";
-      }
-      row.cells[1].className = "";
-    }
-    return;
+
+// --- Profiling heat gutter ---
+// Execution counts per source line beside the program text, shaded on a
+// log scale. Rows follow the textarea's scroll position, so the textarea
+// keeps one row per line (no wrapping) at HEAT_ROW_HEIGHT.
+const HEAT_ROW_HEIGHT = 18;
+const HOT_FUNCTIONS_SHOWN = 5;
+const HOT_OPCODES_SHOWN = 8;
+// Class names then op names, matching jsInstructionMix(); fetched once
+let mixNames = null;
+let lineHeat = new Float64Array(0);
+let heatMax = 0;
+let heatList = null;
+
+function setupHeatGutter() {
+  const gutter = document.getElementById("heatGutter");
+  const ta = document.getElementById("programInput");
+  heatList = createVirtualList(gutter, HEAT_ROW_HEIGHT, renderHeatRow);
+  ta.addEventListener("scroll", () => { gutter.scrollTop = ta.scrollTop; });
+  ta.addEventListener("input", () => { if (profiling) updateHeatGutter(); });
+}
+
+function formatCount(n) {
+  if (n < 1e3) return `${n}`;
+  if (n < 1e6) return `${(n / 1e3).toFixed(1)}k`;
+  if (n < 1e9) return `${(n / 1e6).toFixed(1)}M`;
+  return `${(n / 1e9).toFixed(1)}G`;
+}
+
+function renderHeatRow(row, i) {
+  const n = i < lineHeat.length ? lineHeat[i] : 0;
+  row.className = "virtual-row heat-row";
+  row.textContent = n ? formatCount(n) : "";
+  row.title = n ? `line ${i + 1}: ${n} executions` : "";
+  row.style.background = n ? `rgba(255, 90, 0, ${0.15 + 0.85 * Math.log1p(n) / Math.log1p(heatMax)})` : "";
+}
+
+function updateHeatGutter() {
+  if (!heatList) return;
+  if (profiling) {
+    const count = Module.jsProfileLines();
+    lineHeat = new Float64Array(Module.HEAPU8.buffer, Module.jsProfileData(), count).slice();
+  } else {
+    lineHeat = new Float64Array(0);
+  }
+  heatMax = lineHeat.reduce((a, b) => Math.max(a, b), 0);
+  const lines = document.getElementById("programInput").value.split("\n").length;
+  heatList.setCount(Math.max(lines, lineHeat.length));
+}
+
+// The hottest label-delimited functions, from jsProfileFunctions()
+function printHotFunctions() {
+  const rows = coreText(Module.jsProfileFunctions()).split("\n").filter(Boolean);
+  if (rows.length === 0) return;
+  const total = rows.reduce((sum, r) => sum + Number(r.split("\t")[0]), 0);
+  addConsoleLine("🔥 Hottest functions:", "info");
+  for (const r of rows.slice(0, HOT_FUNCTIONS_SHOWN)) {
+    const [count, start, name] = r.split("\t");
+    addConsoleLine(`   ${name} @ ${start}: ${count} (${(100 * count / total).toFixed(1)}%)`, "info");
   }
+}
 
-  for (let i = 1; i <= limit; i++) {
-    const valCell = tbl.rows[i].cells[1];
-    const v = values[i - 1];
-    const changed = v.dec !== prevMem[i - 1];
-    valCell.textContent = `${v.dec} (${v.hex})`;
-    valCell.className = changed ? "changed" : "";
-    prevMem[i - 1] = v.dec;
+// Instruction classes and the most frequent opcodes, from jsInstructionMix()
+function printInstructionMix() {
+  if (!mixNames) {
+    const [classes, ops] = coreText(Module.jsMixNames()).split("\n\n");
+    mixNames = { classes: classes.split("\n"), ops: ops.split("\n").slice(0, -1) };
   }
+  const count = Module.jsInstructionMix();
+  const mix = new Float64Array(Module.HEAPU8.buffer, Module.jsMixData(), count).slice();
+  const byClass = mix.subarray(0, mixNames.classes.length);
+  const byOp = mix.subarray(mixNames.classes.length);
+  const total = byClass.reduce((a, b) => a + b, 0);
+  if (total === 0) return;
+
+  const pct = (n) => `${(100 * n / total).toFixed(1)}%`;
+  const classes = mixNames.classes.map((name, i) => [name, byClass[i]]).filter(([, n]) => n);
+  addConsoleLine(`📊 Instruction mix: ${classes.map(([name, n]) => `${name} ${pct(n)}`).join(", ")}`, "info");
+  const ops = mixNames.ops.map((name, i) => [name, byOp[i]]).filter(([, n]) => n);
+  ops.sort((a, b) => b[1] - a[1]);
+  addConsoleLine(`   Top opcodes: ${ops.slice(0, HOT_OPCODES_SHOWN).map(([name, n]) => `${name} ${pct(n)}`).join(", ")}`, "info");
+}
 
-  for (let i = limit + 1; i <= totalRows; i++) {
-    const valCell = tbl.rows[i].cells[1];
-    valCell.textContent = "—";
-    valCell.className = "";
+// Estimated cycles, CPI and stalls from jsPipelineReport()
+function printPipelineReport() {
+  addConsoleLine("⏱️ Pipeline estimate:", "info");
+  for (const line of coreText(Module.jsPipelineReport()).split("\n").filter(Boolean)) {
+    addConsoleLine(`   ${line}`, "info");
   }
 }
 
@@ -497,6 +881,11 @@ async function initModule() {
     printErr: (msg) => addConsoleLine(msg, "error"),
   });
 
+  const missing = REQUIRED_BINDINGS.filter((name) => typeof Module[name] !== "function");
+  if (missing.length) {
+    addConsoleLine(`❌ riscv.wasm is out of date (missing ${missing.join(", ")}). Rebuild it with ./build.sh.`, "error");
+    return;
+  }
   addConsoleLine("✅ RISC-V module loaded.", "info");
 
   try {
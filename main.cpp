@@ -1,824 +1,349 @@
-#include <iostream>
-#include <vector>
-#include <string>
-#include <unordered_map>
-#include <sstream>
-#include <iomanip>
+#include "riscv_pipeline.h"
+
+#include <thread>
 #include <emscripten/bind.h>
-using namespace std;
 using namespace emscripten;
 
 //-------------------------------------
-// Instruction representation
+// Emscripten Bindings
 //-------------------------------------
-struct Instruction
-{
-    string op;
-    vector<string> args;
-    int sourceLine = -1;
-};
-
-// ------------------------------------------
-// ABI Register Name Map
-// ------------------------------------------
-static const unordered_map<string, int> ABI_REG_MAP = {
-    // Zero & return
-    {"zero", 0},
-    {"ra", 1},
-    {"sp", 2},
-    {"gp", 3},
-    {"tp", 4},
-
-    // Temporaries
-    {"t0", 5},
-    {"t1", 6},
-    {"t2", 7},
-    {"t3", 28},
-    {"t4", 29},
-    {"t5", 30},
-    {"t6", 31},
-
-    // Saved registers
-    {"s0", 8},
-    {"s1", 9},
-    {"s2", 18},
-    {"s3", 19},
-    {"s4", 20},
-    {"s5", 21},
-    {"s6", 22},
-    {"s7", 23},
-    {"s8", 24},
-    {"s9", 25},
-    {"s10", 26},
-    {"s11", 27},
-
-    // Arguments / return values
-    {"a0", 10},
-    {"a1", 11},
-    {"a2", 12},
-    {"a3", 13},
-    {"a4", 14},
-    {"a5", 15},
-    {"a6", 16},
-    {"a7", 17}};
+SimpleRISCV cpu;
+PipelineModel pipeline; // attached to cpu by jsSetPipeline()
 
 //-------------------------------------
-// RISC-V Emulator core
+// Background runner
 //-------------------------------------
-class SimpleRISCV
+// A run executes on its own thread (a Web Worker under -pthread) while the UI
+// samples registers and memory from the shared heap at display rate. The
+// control words at jsRunControl() are an Int32Array for JS Atomics:
+// RUN_STOP is set by the UI to stop the run, RUN_STATE is published by
+// the runner.
+enum RunWord : int
 {
-public:
-    vector<int> reg;
-    vector<uint8_t> memory; // byte-addressable memory (e.g., 4 KiB)
-    unordered_map<string, int> labels;
-    vector<Instruction> program;
-    int pc = 0;
-
-    SimpleRISCV()
-    {
-        reg.assign(32, 0);
-        memory.assign(4096, 0);
-        // Initialize stack pointer (x2 = sp) to end of memory
-        reg[2] = memory.size();     // top of 4 KB stack region
-        reg[3] = memory.size() / 2; // gp
-    }
-
-    //---------------------------------
-    // Program loading and parsing
-    //---------------------------------
-    void loadProgram(const vector<string> &lines)
-    {
-        program.clear();
-        labels.clear();
-        pc = 0;
-
-        for (size_t lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
-        {
-            string rawLine = lines[lineIndex];
-            string line = trim(rawLine);
-
-            if (line.empty() || line[0] == '#')
-                continue;
-            size_t commentPos = line.find('#');
-            if (commentPos != string::npos)
-                line = trim(line.substr(0, commentPos));
-            if (line.empty())
-                continue;
-
-            // --- Handle labels ---
-            while (true)
-            {
-                size_t pos = line.find(':');
-                if (pos == string::npos)
-                    break;
-                string label = trim(line.substr(0, pos));
-                if (!label.empty())
-                    labels[label] = program.size() * 4;
-                line = (pos + 1 < line.size()) ? line.substr(pos + 1) : "";
-                line = trim(line);
-            }
-            if (line.empty())
-                continue;
-
-            // --- Parse instruction ---
-            stringstream ss(line);
-            Instruction inst;
-            ss >> inst.op;
-            inst.sourceLine = (int)lineIndex; // 🟢 assign the source line here
-
-            // normalize
-            for (auto &ch : inst.op)
-                ch = toupper(ch);
-
-            string argsPart;
-            getline(ss, argsPart);
-            argsPart = trim(argsPart);
-            for (char &ch : argsPart)
-                if (ch == ',')
-                    ch = ' ';
-            stringstream as(argsPart);
-            string arg;
-            while (as >> arg)
-                inst.args.push_back(arg);
-
-            // expand pseudo-instructions
-            auto seq = expandPseudo(inst);
-
-            // 🟢 propagate the source line number
-            for (auto &e : seq)
-            {
-                e.sourceLine = inst.sourceLine;
-                program.push_back(e);
-            }
-        }
-
-        cerr << "[RISC-V] Program loaded: " << program.size()
-             << " instructions, " << labels.size() << " labels.\n";
-    }
-
-    //---------------------------------
-    // Step execution
-    //---------------------------------
-    bool step()
-    {
-        // enforce x0 = 0
-        reg[0] = 0;
-
-        int index = pc / 4;
-        if (index < 0 || index >= (int)program.size())
-        {
-            cerr << "[RISC-V] PC out of range — halting.\n";
-            return false;
-        }
-
-        Instruction &inst = program[index];
-        string op = inst.op;
-
-        // Log every instruction executed
-        cerr << "[Exec] " << toString(inst) << " (PC=" << pc << ", Line=" << inst.sourceLine << ")\n";
-
-        if (op == "LA")
-        {
-            int rd = regNum(inst.args[0]);
-            string label = inst.args[1];
-
-            if (!labels.count(label))
-            {
-                cerr << "[Warning] LA label not found: " << label << "\n";
-                pc += 4;
-                return true;
-            }
-
-            int addr = labels[label];
-            int upper = (addr + 0x800) >> 12;
-            int lower = addr & 0xFFF;
-            if (lower & 0x800)
-                lower -= 0x1000; // sign-fix
+    RUN_STOP = 0,
+    RUN_STATE = 1,
+};
+enum RunState : int32_t
+{
+    RUN_IDLE = 0,
+    RUN_RUNNING = 1,
+    RUN_HALTED = 2,  // the program stopped (ECALL, fault, ...)
+    RUN_STOPPED = 3, // RUN_STOP was set
+    RUN_LIMIT = 4,   // the instruction limit was reached
+};
+static_assert(sizeof(atomic<int32_t>) == sizeof(int32_t) && atomic<int32_t>::is_always_lock_free);
 
-            writeReg(rd, (upper << 12) + lower); // emulate LUI+ADDI
-            pc += 4;
-            return true;
-        }
-        // -------- Arithmetic / Logic --------
-        else if (op == "ADD")
-            alu3(inst, [](int a, int b)
-                 { return a + b; });
-        else if (op == "ADDI")
-            aluI(inst, [](int a, int b)
-                 { return a + b; });
-        else if (op == "SUB")
-            alu3(inst, [](int a, int b)
-                 { return a - b; });
-        else if (op == "MUL")
-            alu3(inst, [](int a, int b)
-                 { return a * b; });
-        else if (op == "DIV")
-            alu3(inst, [](int a, int b)
-                 { return b ? a / b : 0; });
-        else if (op == "REM")
-            alu3(inst, [](int a, int b)
-                 { return b ? a % b : 0; });
-        else if (op == "AND")
-            alu3(inst, [](int a, int b)
-                 { return a & b; });
-        else if (op == "OR")
-            alu3(inst, [](int a, int b)
-                 { return a | b; });
-        else if (op == "XOR")
-            alu3(inst, [](int a, int b)
-                 { return a ^ b; });
-        else if (op == "SLL")
-            alu3(inst, [](int a, int b)
-                 { return a << (b & 0x1F); });
-        else if (op == "SRL")
-            alu3(inst, [](int a, int b)
-                 { return (unsigned)a >> (b & 0x1F); });
-        else if (op == "SRA")
-            alu3(inst, [](int a, int b)
-                 { return a >> (b & 0x1F); });
-        else if (op == "SLT")
-            alu3(inst, [](int a, int b)
-                 { return a < b ? 1 : 0; });
-        else if (op == "SLLI")
-            aluI(inst, [](int a, int shamt)
-                 { return a << (shamt & 0x1F); });
-        else if (op == "SRLI")
-            aluI(inst, [](int a, int shamt)
-                 { return (unsigned)a >> (shamt & 0x1F); });
-        else if (op == "SRAI")
-            aluI(inst, [](int a, int shamt)
-                 { return a >> (shamt & 0x1F); });
-        else if (op == "SLTU")
-            alu3(inst, [](unsigned a, unsigned b)
-                 { return a < b ? 1 : 0; });
-        else if (op == "SLTI")
-            aluI(inst, [](int a, int b)
-                 { return a < b ? 1 : 0; });
-        else if (op == "SLTIU")
-            aluI(inst, [](unsigned a, unsigned b)
-                 { return a < b ? 1 : 0; });
-        else if (op == "XORI")
-            aluI(inst, [](int a, int b)
-                 { return a ^ b; });
-        else if (op == "ORI")
-            aluI(inst, [](int a, int b)
-                 { return a | b; });
-        else if (op == "ANDI")
-            aluI(inst, [](int a, int b)
-                 { return a & b; });
-
-        // -------- Memory --------
-        else if (op == "LB" || op == "LBU" || op == "LH" || op == "LHU" || op == "LW")
-        {
-            int rd = regNum(inst.args[0]);
-            auto [imm, rs1] = parseMem(inst.args[1]);
-            imm = signExtend12(imm);
+// A background run checks RUN_STOP between slices of this much run time
+constexpr uint32_t RUN_SLICE_US = 1000;
 
-            int addr = reg[rs1] + imm;
+atomic<int32_t> runControl[2] = {0, RUN_IDLE};
+thread runner;
 
-            if (op == "LB")
-            {
-                // byte load: no alignment
-                if (!validAddrByte(addr))
-                    return false;
-                int v = sext8(load8(addr));
-                writeReg(rd, v);
-            }
-            else if (op == "LBU")
-            {
-                if (!validAddrByte(addr))
-                    return false;
-                int v = zext8(load8(addr));
-                writeReg(rd, v);
-            }
-            else if (op == "LH")
-            {
-                if (!checkAligned(addr, 2, "LH") || !validAddrByte(addr + 1))
-                    return false;
-                int v = sext16(load16(addr));
-                writeReg(rd, v);
-            }
-            else if (op == "LHU")
-            {
-                if (!checkAligned(addr, 2, "LHU") || !validAddrByte(addr + 1))
-                    return false;
-                int v = zext16(load16(addr));
-                writeReg(rd, v);
-            }
-            else
-            { // LW
-                if (!checkAligned(addr, 4, "LW") || !validAddrByte(addr + 3))
-                    return false;
-                int v = (int)load32(addr);
-                writeReg(rd, v);
-            }
-        }
-        else if (op == "SB" || op == "SH" || op == "SW")
-        {
-            int rs2 = regNum(inst.args[0]);
-            auto [imm, rs1] = parseMem(inst.args[1]);
-            imm = signExtend12(imm);
-
-            int addr = reg[rs1] + imm;
-
-            if (op == "SB")
-            {
-                if (!validAddrByte(addr))
-                    return false;
-                store8(addr, (uint8_t)(reg[rs2] & 0xFF));
-            }
-            else if (op == "SH")
-            {
-                if (!checkAligned(addr, 2, "SH") || !validAddrByte(addr + 1))
-                    return false;
-                store16(addr, (uint16_t)(reg[rs2] & 0xFFFF));
-            }
-            else
-            { // SW
-                if (!checkAligned(addr, 4, "SW") || !validAddrByte(addr + 3))
-                    return false;
-                store32(addr, (uint32_t)reg[rs2]);
-            }
-        }
+// Stops a background run, if any, and waits for it; every other binding
+// that touches the CPU calls this first
+void jsStopRun()
+{
+    if (!runner.joinable())
+        return;
+    runControl[RUN_STOP].store(1);
+    runner.join();
+}
 
-        // -------- Branch / Jump --------
-        else if (op == "BEQ" || op == "BNE" || op == "BLT" || op == "BGE" || op == "BLTU" || op == "BGEU")
+// Starts a background run of up to `maxInstructions` (0: no limit)
+void jsStartRun(uint32_t maxInstructions)
+{
+    jsStopRun();
+    runControl[RUN_STOP].store(0);
+    runControl[RUN_STATE].store(RUN_RUNNING);
+    runner = thread([maxInstructions]
+                    {
+        cpu.traceExec = false;
+        int32_t state = RUN_LIMIT;
+        const uint64_t limit = maxInstructions ? cpu.instret + maxInstructions : 0;
+        while (!limit || cpu.instret < limit)
         {
-            int rs1 = regNum(inst.args[0]);
-            int rs2 = regNum(inst.args[1]);
-            string t = inst.args[2];
-
-            // compute byte offset (label or immediate)
-            int offset = (labels.count(t) ? labels[t] - pc : signExtend12(parseNumber(t)));
-
-            bool take = false;
-
-            if (op == "BEQ")
-                take = (reg[rs1] == reg[rs2]);
-            else if (op == "BNE")
-                take = (reg[rs1] != reg[rs2]);
-            else if (op == "BLT")
-                take = (reg[rs1] < reg[rs2]);
-            else if (op == "BGE")
-                take = (reg[rs1] >= reg[rs2]);
-            else if (op == "BLTU")
-                take = ((unsigned)reg[rs1] < (unsigned)reg[rs2]);
-            else if (op == "BGEU")
-                take = ((unsigned)reg[rs1] >= (unsigned)reg[rs2]);
-
-            if (take)
+            if (runControl[RUN_STOP].load(memory_order_relaxed))
             {
-                pc += offset;
-                cerr << "[RISC-V] " << op << " taken → PC=" << pc << "\n";
-                return true;
+                state = RUN_STOPPED;
+                break;
             }
-            else
+            if (!cpu.runFor(RUN_SLICE_US, limit ? limit - cpu.instret : 0))
             {
-                cerr << "[RISC-V] " << op << " not taken → next PC=" << pc + 4 << "\n";
+                state = RUN_HALTED;
+                break;
             }
         }
+        cpu.traceExec = true;
+        runControl[RUN_STATE].store(state); });
+}
 
-        else if (op == "JAL")
-        {
-            int rd = regNum(inst.args[0]);
-            string label = inst.args[1];
-            writeReg(rd, pc + 4);
-
-            if (labels.count(label))
-            {
-                pc = labels[label];
-            }
-            else
-            {
-                // Allow numeric immediate jumps (e.g., offsets)
-                try
-                {
-                    int offset = parseNumber(label);
-                    pc += offset;
-                }
-                catch (...)
-                {
-                    cerr << "[Warning] JAL target not found: " << label << "\n";
-                    pc += 4;
-                }
-            }
+// Runs on the calling thread for up to `micros` of wall time and
+// `maxInstructions` (0: no limit); for pages without cross-origin isolation,
+// which call it once per animation frame. Returns RUN_RUNNING while the
+// program can continue, RUN_HALTED once it stops.
+int32_t jsRunFor(uint32_t micros, uint32_t maxInstructions)
+{
+    jsStopRun();
+    cpu.traceExec = false;
+    bool running = cpu.runFor(micros, maxInstructions);
+    cpu.traceExec = true;
+    return running ? RUN_RUNNING : RUN_HALTED;
+}
 
-            cerr << "[RISC-V] JAL → " << label << " (PC=" << pc << ")\n";
-            return true;
-        }
-        else if (op == "JALR")
-        {
-            int rd = regNum(inst.args[0]);
-            auto [imm, rs1] = parseMem(inst.args[1]);
-            imm = signExtend12(imm);
-            writeReg(rd, pc + 4);
-            pc = (reg[rs1] + imm) & ~1;
-            cerr << "[RISC-V] JALR → addr=" << pc << "\n";
-            return true;
-        }
-        else if (op == "LUI")
-        {
-            int rd = regNum(inst.args[0]);
-            int imm = parseNumber(inst.args[1]);
-            writeReg(rd, imm << 12);
-        }
-        else if (op == "AUIPC")
-        {
-            int rd = regNum(inst.args[0]);
-            int imm = parseNumber(inst.args[1]);
-            writeReg(rd, pc + (imm << 12));
-        }
-        else if (op == "ECALL")
-        {
-            cerr << "[RISC-V] ECALL — program halted.\n";
-            return false;
-        }
+uintptr_t jsRunControl() { return reinterpret_cast<uintptr_t>(runControl); }
 
-        // -------- Normal sequential flow --------
-        reg[0] = 0;
-        pc += 4;
-        return true;
-    }
+// A new core for the next program; modes set from the UI (profiling,
+// pipeline timing) carry over
+void freshCpu()
+{
+    jsStopRun();
+    bool profiling = cpu.profiling;
+    TimingModel *timing = cpu.timing;
+    cpu = SimpleRISCV();
+    cpu.profiling = profiling;
+    cpu.timing = timing;
+}
 
-    static string toString(const Instruction &inst)
-    {
-        string s = inst.op;
-        if (!inst.args.empty())
-        {
-            s += " ";
-            for (size_t i = 0; i < inst.args.size(); i++)
-            {
-                s += inst.args[i];
-                if (i + 1 < inst.args.size())
-                    s += ", ";
-            }
-        }
-        return s;
-    }
+void jsLoadProgram(string src)
+{
+    freshCpu();
+    cpu.loadProgram(move(src));
+}
 
-    //---------------------------------
-    // Dump state for GUI
-    //---------------------------------
-    string dumpState() const
-    {
-        stringstream ss;
-        ss << "PC=0x" << hex << pc << dec << "\n";
-        for (int i = 0; i < 32; i++)
-        {
-            ss << "x" << setfill('0') << setw(2) << i << setfill(' ')
-               << "=" << setw(11) << reg[i]
-               << ((i + 1) % 8 == 0 ? "\n" : "  ");
-        }
+// Large sources: scan only; each .text instruction is assembled when it
+// is first executed or accessed
+void jsLoadProgramLazy(string src)
+{
+    freshCpu();
+    cpu.lazyAssembly = true;
+    cpu.loadProgram(move(src));
+}
 
-        // Show first 64 words (256 bytes), reconstructed little-endian
-        ss << "\nMemory[words 0..63]: ";
-        int maxWords = min(64, (int)memory.size() / 4);
-        for (int w = 0; w < maxWords; ++w)
-        {
-            int addr = w * 4;
-            uint32_t val = (uint32_t)(memory[addr] |
-                                      (memory[addr + 1] << 8) |
-                                      (memory[addr + 2] << 16) |
-                                      (memory[addr + 3] << 24));
-            ss << dec << val << "(" << hex << showbase << val << noshowbase << dec << ") ";
-        }
-        ss << "\n";
-        return ss.str();
-    }
+// Re-assemble after an edit replaced `removed` lines at `first` (0-based)
+void jsUpdateLines(int first, int removed, string text)
+{
+    jsStopRun();
+    cpu.updateLines(max(first, 0), max(removed, 0), move(text));
+}
 
-    //---------------------------------
-    // Read memory (for search)
-    //---------------------------------
-    uint8_t *getMemoryData() { return memory.data(); }
-    size_t getMemorySize() const { return memory.size(); }
+// Raw machine code, passed from JS as a Uint8Array
+void jsLoadBinary(string bytes, int base)
+{
+    freshCpu();
+    cpu.loadBinary(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), base);
+}
 
-    // For Line Highlights
-    int getSourceLineForPC(int pcValue) const
-    {
-        int idx = pcValue / 4;
-        if (idx < 0 || idx >= (int)program.size())
-            return -1;
-        return program[idx].sourceLine;
-    }
+bool jsLoadElf(string bytes)
+{
+    jsStopRun();
+    return cpu.loadElf(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size());
+}
 
-private:
-    //---------------------------------
-    // Helpers
-    //---------------------------------
-    void writeReg(int rd, int val)
-    {
-        if (rd != 0)
-            reg[rd] = val;
-    }
+// Compiled-program cache; the web build keeps entries in IndexedDB (index.js)
+vector<uint8_t> cacheBlob;
 
-    template <typename F>
-    void alu3(const Instruction &ins, F fn)
-    {
-        int rd = regNum(ins.args[0]);
-        int rs1 = regNum(ins.args[1]);
-        int rs2 = regNum(ins.args[2]);
-        writeReg(rd, fn(reg[rs1], reg[rs2]));
-    }
+string jsProgramCacheKey(string src)
+{
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)SimpleRISCV::programCacheKey(src));
+    return key;
+}
 
-    template <typename F>
-    void aluI(const Instruction &ins, F fn)
-    {
-        int rd = regNum(ins.args[0]);
-        int rs1 = regNum(ins.args[1]);
-        int imm = signExtend12(parseNumber(ins.args[2]));
-        writeReg(rd, fn(reg[rs1], imm));
-    }
+static uint64_t parseCacheKey(const string &key)
+{
+    uint64_t v = 0;
+    from_chars(key.data(), key.data() + key.size(), v, 16);
+    return v;
+}
 
-    pair<int, int> parseMem(const string &s) const
-    {
-        size_t lparen = s.find('(');
-        size_t rparen = s.find(')');
-        if (lparen == string::npos || rparen == string::npos)
-            throw runtime_error("Invalid memory syntax: " + s);
+bool jsLoadCachedProgram(string src, string key, string blob)
+{
+    freshCpu();
+    return cpu.loadProgramCache(reinterpret_cast<const uint8_t *>(blob.data()), blob.size(), src, parseCacheKey(key));
+}
 
-        string immStr = s.substr(0, lparen);
-        string rsStr = s.substr(lparen + 1, rparen - lparen - 1);
+// Serializes the program just loaded; returns its size (0: not cacheable).
+// The bytes are at jsProgramCacheData() until the next call.
+int jsSaveProgramCache(string key)
+{
+    return cpu.saveProgramCache(parseCacheKey(key), cacheBlob) ? (int)cacheBlob.size() : 0;
+}
 
-        int imm = parseNumber(immStr);
-        int rs = regNum(rsStr);
-        return {imm, rs};
-    }
+uintptr_t jsProgramCacheData() { return reinterpret_cast<uintptr_t>(cacheBlob.data()); }
 
-    static int regNum(const string &s)
-    {
-        string name = s;
-        // lowercase everything for consistency
-        for (auto &c : name)
-            c = tolower(c);
+bool jsStep()
+{
+    jsStopRun();
+    return cpu.step();
+}
 
-        // Handle xN format
-        if (!name.empty() && name[0] == 'x')
-        {
-            try
-            {
-                return parseNumber(name.substr(1));
-            }
-            catch (...)
-            {
-                cerr << "[Error] Invalid register: " << s << "\n";
-                return 0;
-            }
-        }
+// Changes since the last call; the record layout is RiscvCore::consumeDelta's
+uintptr_t jsConsumeDelta() { return reinterpret_cast<uintptr_t>(cpu.consumeDelta().data()); }
 
-        // Handle ABI register name
-        auto it = ABI_REG_MAP.find(name);
-        if (it != ABI_REG_MAP.end())
-            return it->second;
+// Text results (state dumps, event lines) go into one UTF-8 buffer that JS
+// views at jsTextData() and decodes only what it shows, instead of Embind
+// copying and transcoding a std::string per call. Functions that write it
+// return the length; the bytes stay valid until the next such call.
+string textOut;
 
-        cerr << "[Warning] Unknown register name: " << s << " → default x0\n";
-        return 0;
-    }
+uintptr_t jsTextData() { return reinterpret_cast<uintptr_t>(textOut.data()); }
 
-    static string trim(string s)
+// Execution events: jsDrainEvents() moves them into the array at
+// jsEventsPtr() (32-byte Event records) and returns the count;
+// jsFormatEvents() renders `count` records from `first` as console lines,
+// each ending in '\n'
+uint32_t jsDrainEvents() { return (uint32_t)cpu.drainEvents(); }
+uintptr_t jsEventsPtr() { return reinterpret_cast<uintptr_t>(cpu.getEventsPtr()); }
+uint32_t jsFormatEvents(uint32_t first, uint32_t count)
+{
+    textOut.resize((size_t)count * (EVENT_TEXT_MAX + 1));
+    char *p = textOut.data();
+    for (const Event *e = cpu.getEventsPtr() + first, *end = e + count; e != end; ++e)
     {
-        size_t a = s.find_first_not_of(" \t"), b = s.find_last_not_of(" \t");
-        return a == string::npos ? "" : s.substr(a, b - a + 1);
+        p += formatEvent(*e, p);
+        *p++ = '\n';
     }
+    textOut.resize(p - textOut.data());
+    return (uint32_t)textOut.size();
+}
 
-    static int parseNumber(const string &numStr)
-    {
-        string s = trim(numStr);
-        if (s.empty())
-            return 0;
-
-        auto to32 = [](long long v) -> int
-        {
-            uint32_t u = static_cast<uint32_t>(v); // wrap like RV32
-            return static_cast<int>(u);            // interpret as signed
-        };
-
-        try
-        {
-            if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
-            {
-                long long v = stoll(s, nullptr, 16);
-                return to32(v);
-            }
-            if (s.size() > 3 && s[0] == '-' && s[1] == '0' && (s[2] == 'x' || s[2] == 'X'))
-            {
-                long long v = stoll(s.substr(1), nullptr, 16);
-                return to32(-v);
-            }
-            long long v = stoll(s, nullptr, 10);
-            return to32(v);
-        }
-        catch (...)
-        {
-            cerr << "[Error] Bad immediate: " << s << "\n";
-            return 0;
-        }
-    }
+uint32_t jsDumpState()
+{
+    textOut = cpu.dumpState();
+    return (uint32_t)textOut.size();
+}
 
-    static inline int signExtend12(int imm)
-    {
-        return (imm << 20) >> 20; // keep lower 12 bits, sign-extend
-    }
+// Profiling: jsProfileLines() puts per-line execution counts at
+// jsProfileData() as doubles (exact up to 2^53) and returns how many;
+// jsProfileFunctions() writes "count\tstart\tname" lines, hottest first,
+// to the text buffer
+vector<double> profileOut;
 
-    bool validAddr(int addr) const
-    {
-        if (addr < 0 || addr >= (int)memory.size() * 4)
-        {
-            cerr << "[Warning] Memory access out of bounds at address 0x"
-                 << hex << addr << dec
-                 << " (valid range: 0–" << (memory.size() * 4 - 4) << ")\n";
-            return false;
-        }
-        return true;
-    }
+void jsSetProfiling(bool on)
+{
+    jsStopRun();
+    cpu.setProfiling(on);
+}
 
-    // ---- Address checks ----
-    bool validAddrByte(int addr) const
-    {
-        if (addr < 0 || addr >= (int)memory.size())
-        {
-            cerr << "[Warning] Memory access OOB at 0x" << hex << addr << dec
-                 << " (valid 0.." << (int)memory.size() - 1 << ")\n";
-            return false;
-        }
-        return true;
-    }
-    bool checkAligned(int addr, int align, const char *what) const
-    {
-        if (addr % align != 0)
-        {
-            cerr << "[Warning] Misaligned " << what << " at 0x"
-                 << hex << addr << dec << " (align " << align << ")\n";
-            return false;
-        }
-        return true;
-    }
+uint32_t jsProfileLines()
+{
+    vector<uint64_t> counts = cpu.profileByLine();
+    profileOut.assign(counts.begin(), counts.end());
+    return (uint32_t)profileOut.size();
+}
 
-    // ---- Little-endian loads ----
-    uint8_t load8(int addr) const
-    {
-        if (!validAddrByte(addr))
-            return 0;
-        return memory[addr];
-    }
-    uint16_t load16(int addr) const
-    {
-        if (!validAddrByte(addr) || !validAddrByte(addr + 1))
-            return 0;
-        // little-endian
-        return (uint16_t)(memory[addr] | (memory[addr + 1] << 8));
-    }
-    uint32_t load32(int addr) const
-    {
-        if (!validAddrByte(addr) || !validAddrByte(addr + 3))
-            return 0;
-        return (uint32_t)(memory[addr] | (memory[addr + 1] << 8) | (memory[addr + 2] << 16) | (memory[addr + 3] << 24));
-    }
+uintptr_t jsProfileData() { return reinterpret_cast<uintptr_t>(profileOut.data()); }
 
-    // ---- Little-endian stores ----
-    void store8(int addr, uint8_t v)
-    {
-        if (!validAddrByte(addr))
-            return;
-        memory[addr] = v;
-    }
-    void store16(int addr, uint16_t v)
-    {
-        if (!validAddrByte(addr) || !validAddrByte(addr + 1))
-            return;
-        memory[addr] = (uint8_t)(v & 0xFF);
-        memory[addr + 1] = (uint8_t)((v >> 8) & 0xFF);
-    }
-    void store32(int addr, uint32_t v)
+uint32_t jsProfileFunctions()
+{
+    textOut.clear();
+    for (const auto &f : cpu.profileByFunction())
     {
-        if (!validAddrByte(addr) || !validAddrByte(addr + 3))
-            return;
-        memory[addr] = (uint8_t)(v & 0xFF);
-        memory[addr + 1] = (uint8_t)((v >> 8) & 0xFF);
-        memory[addr + 2] = (uint8_t)((v >> 16) & 0xFF);
-        memory[addr + 3] = (uint8_t)((v >> 24) & 0xFF);
+        char head[48];
+        int n = snprintf(head, sizeof(head), "%llu\t0x%llx\t", (unsigned long long)f.count, (unsigned long long)f.start);
+        textOut.append(head, n).append(f.name) += '\n';
     }
+    return (uint32_t)textOut.size();
+}
 
-    // ---- Sign/zero extension helpers ----
-    static int sext8(uint8_t v) { return (int)(int8_t)v; }
-    static int sext16(uint16_t v) { return (int)(int16_t)v; }
-    static int zext8(uint8_t v) { return (int)v; }
-    static int zext16(uint16_t v) { return (int)v; }
-
-    //--- Pseudo Helpers
-    vector<Instruction> expandPseudo(const Instruction &instIn)
-    {
-        Instruction inst = instIn;
-        string op = inst.op;
-        for (auto &c : op)
-            c = toupper(c);
-
-        // --- MV rd, rs → ADDI rd, rs, 0 ---
-        if (op == "MV" && inst.args.size() == 2)
-        {
-            Instruction addi{"ADDI", {inst.args[0], inst.args[1], "0"}};
-            addi.sourceLine = inst.sourceLine;
-            return {addi};
-        }
-
-        // --- LI rd, imm ---
-        if (op == "LI" && inst.args.size() == 2)
-        {
-            string rd = inst.args[0];
-            int imm = parseNumber(inst.args[1]);
-
-            if (imm >= -2048 && imm <= 2047)
-            {
-                Instruction addi{"ADDI", {rd, "x0", to_string(imm)}};
-                addi.sourceLine = inst.sourceLine;
-                return {addi};
-            }
-            else
-            {
-                uint32_t uimm = static_cast<uint32_t>(imm);
-                int upper = static_cast<int>((uimm + 0x800) >> 12);
-                int lower = static_cast<int>(uimm & 0xFFF);
-                if (lower & 0x800)
-                    lower -= 0x1000;
-
-                Instruction lui{"LUI", {rd, to_string(upper)}};
-                Instruction addi{"ADDI", {rd, rd, to_string(lower)}};
-                lui.sourceLine = inst.sourceLine;
-                addi.sourceLine = inst.sourceLine;
-                return {lui, addi};
-            }
-        }
-
-        // --- LA rd, label ---
-        if (op == "LA" && inst.args.size() == 2)
-        {
-            Instruction la{"LA", {inst.args[0], inst.args[1]}};
-            la.sourceLine = inst.sourceLine;
-            return {la};
-        }
-
-        // --- J label ---
-        if (op == "J" && inst.args.size() == 1)
-        {
-            Instruction jal{"JAL", {"x0", inst.args[0]}};
-            jal.sourceLine = inst.sourceLine;
-            return {jal};
-        }
-
-        // --- JR rs ---
-        if (op == "JR" && inst.args.size() == 1)
-        {
-            Instruction jalr{"JALR", {"x0", "0(" + inst.args[0] + ")"}};
-            jalr.sourceLine = inst.sourceLine;
-            return {jalr};
-        }
+// Instruction mix: jsInstructionMix() puts the per-class counts followed by
+// the per-op counts at jsMixData() as doubles and returns how many;
+// jsMixNames() writes the matching names to the text buffer, one per line,
+// with a blank line between the classes and the ops
+vector<double> mixOut;
 
-        // --- RET ---
-        if (op == "RET")
-        {
-            Instruction jalr{"JALR", {"x0", "0(x1)"}};
-            jalr.sourceLine = inst.sourceLine;
-            return {jalr};
-        }
+uint32_t jsInstructionMix()
+{
+    auto mix = cpu.instructionMix();
+    mixOut.assign(begin(mix.byClass), end(mix.byClass));
+    mixOut.insert(mixOut.end(), begin(mix.byOp), end(mix.byOp));
+    return (uint32_t)mixOut.size();
+}
 
-        // --- Default (unchanged) ---
-        Instruction unchanged = instIn;
-        unchanged.sourceLine = inst.sourceLine;
-        return {unchanged};
-    }
-};
+uintptr_t jsMixData() { return reinterpret_cast<uintptr_t>(mixOut.data()); }
 
-//-------------------------------------
-// Emscripten Bindings
-//-------------------------------------
-SimpleRISCV cpu;
+uint32_t jsMixNames()
+{
+    textOut.clear();
+    for (const char *name : INST_CLASS_NAMES)
+        textOut.append(name) += '\n';
+    textOut += '\n';
+    for (const OpInfo &info : OP_INFO)
+        textOut.append(info.name) += '\n';
+    return (uint32_t)textOut.size();
+}
 
-void jsLoadProgram(string src)
+// Pipeline timing: jsSetPipeline() attaches or detaches the model, applying
+// "key=value,..." settings (see PipelineModel::configure) and clearing its
+// counts; false if the settings are invalid. jsPipelineReport() writes the
+// cycle count, CPI and stalls to the text buffer.
+bool jsSetPipeline(bool on, string settings)
 {
-    vector<string> lines;
-    string line;
-    stringstream ss(src);
-    while (getline(ss, line))
-        lines.push_back(line);
-    cpu = SimpleRISCV();
-    cpu.loadProgram(lines);
+    jsStopRun();
+    if (!pipeline.configure(settings))
+        return false;
+    pipeline.reset();
+    cpu.timing = on ? &pipeline : nullptr;
+    return true;
 }
 
-bool jsStep() { return cpu.step(); }
-string jsDumpState() { return cpu.dumpState(); }
+uint32_t jsPipelineReport()
+{
+    textOut = pipeline.report();
+    return (uint32_t)textOut.size();
+}
 
 SimpleRISCV *getCpuInstance() { return &cpu; }
 
+int jsXlen() { return RISCV_XLEN; }
+
+// Instructions executed since the program was loaded; a double, so exact
+// up to 2^53 without BigInt
+double jsInstret() { return (double)cpu.instret; }
+
 EMSCRIPTEN_BINDINGS(riscv_bindings)
 {
     emscripten::function("jsLoadProgram", &jsLoadProgram);
+    emscripten::function("jsLoadProgramLazy", &jsLoadProgramLazy);
+    emscripten::function("jsUpdateLines", &jsUpdateLines);
+    emscripten::function("jsProgramCacheKey", &jsProgramCacheKey);
+    emscripten::function("jsLoadCachedProgram", &jsLoadCachedProgram);
+    emscripten::function("jsSaveProgramCache", &jsSaveProgramCache);
+    emscripten::function("jsProgramCacheData", &jsProgramCacheData);
+    emscripten::function("jsLoadBinary", &jsLoadBinary);
+    emscripten::function("jsLoadElf", &jsLoadElf);
     emscripten::function("jsStep", &jsStep);
+    emscripten::function("jsStartRun", &jsStartRun);
+    emscripten::function("jsRunFor", &jsRunFor);
+    emscripten::function("jsStopRun", &jsStopRun);
+    emscripten::function("jsRunControl", &jsRunControl);
+    emscripten::function("jsConsumeDelta", &jsConsumeDelta);
+    emscripten::function("jsDrainEvents", &jsDrainEvents);
+    emscripten::function("jsEventsPtr", &jsEventsPtr);
+    emscripten::function("jsFormatEvents", &jsFormatEvents);
+    emscripten::function("jsTextData", &jsTextData);
     emscripten::function("jsDumpState", &jsDumpState);
+    emscripten::function("jsSetProfiling", &jsSetProfiling);
+    emscripten::function("jsProfileLines", &jsProfileLines);
+    emscripten::function("jsProfileData", &jsProfileData);
+    emscripten::function("jsProfileFunctions", &jsProfileFunctions);
+    emscripten::function("jsInstructionMix", &jsInstructionMix);
+    emscripten::function("jsMixData", &jsMixData);
+    emscripten::function("jsMixNames", &jsMixNames);
+    emscripten::function("jsSetPipeline", &jsSetPipeline);
+    emscripten::function("jsPipelineReport", &jsPipelineReport);
     emscripten::function("getCpuInstance", &getCpuInstance, emscripten::allow_raw_pointers());
+    emscripten::function("jsXlen", &jsXlen);
+    emscripten::function("jsInstret", &jsInstret);
 
     emscripten::class_<SimpleRISCV>("SimpleRISCV")
         .function("getMemorySize", &SimpleRISCV::getMemorySize)
         .function("getSourceLineForPC", &SimpleRISCV::getSourceLineForPC)
+        .function("getSymbolForPC", &SimpleRISCV::getSymbolForPC)
         .function("getMemoryData",
                   emscripten::optional_override([](SimpleRISCV &self)
-                                                { return reinterpret_cast<uintptr_t>(self.getMemoryData()); }));
+                                                { return reinterpret_cast<uintptr_t>(self.getMemoryData()); }))
+        .function("getRegsPtr",
+                  emscripten::optional_override([](SimpleRISCV &self)
+                                                { return reinterpret_cast<uintptr_t>(self.getRegsPtr()); }));
 }
@@ -0,0 +1,3553 @@
+// RISC-V core: assembler, decoder, interpreter and loaders. Free of
+// Emscripten, so it builds both into the web module (main.cpp) and natively
+// (riscv_run.cpp).
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <unordered_map>
+#include <deque>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <type_traits>
+#include <utility>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+//-------------------------------------
+// Parsed source statement (assembler input)
+//-------------------------------------
+// Operands are views into the source text, so parsing a line never
+// allocates. Instructions take at most three.
+struct Operands
+{
+    array<string_view, 3> items{};
+    size_t count = 0; // every operand seen, even past items.size()
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    string_view operator[](size_t i) const { return items[i]; }
+    void push_back(string_view s)
+    {
+        if (count < items.size())
+            items[count] = s;
+        ++count;
+    }
+};
+
+struct Instruction
+{
+    string_view op;       // mnemonic or directive
+    Operands args;        // split operands
+    string_view operands; // operand text as written (directive payloads)
+    int sourceLine = -1;
+    int section = 0;     // SECTION_TEXT or SECTION_DATA
+    uint32_t offset = 0; // byte offset within its section
+    uint32_t size = 0;   // bytes emitted
+    bool pending = false; // lazy assembly: sized by the scan, not parsed yet
+};
+
+// A label and the statement position it names
+struct LabelDef
+{
+    string_view name;
+    int sourceLine = -1;
+    int section = 0;
+    uint32_t offset = 0;
+};
+
+enum Section : int
+{
+    SECTION_TEXT = 0,
+    SECTION_DATA = 1,
+};
+
+constexpr char asciiLower(char c) { return c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c; }
+
+constexpr bool iequals(string_view a, string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (asciiLower(a[i]) != asciiLower(b[i]))
+            return false;
+    return true;
+}
+
+//-------------------------------------
+// Compile-time name tables
+//-------------------------------------
+// Case-insensitive perfect hashes for the fixed name sets (mnemonics,
+// registers, CSRs, directives). Hash-and-displace: a name's hash picks a
+// bucket, whose displacement was chosen at compile time so that every name
+// lands in its own slot. A lookup hashes the name once, probes one slot and
+// compares once, without copying or allocating.
+struct NameValue
+{
+    string_view name;
+    int value;
+};
+
+// FNV-1a over the lower-cased name
+constexpr uint32_t nameHash(string_view s)
+{
+    uint32_t h = 2166136261u;
+    for (char c : s)
+        h = (h ^ (uint8_t)asciiLower(c)) * 16777619u;
+    return h;
+}
+
+constexpr uint32_t displacedSlot(uint32_t h, uint32_t d)
+{
+    h ^= d * 0x9E3779B9u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    return h ^ (h >> 12);
+}
+
+template <size_t N>
+struct NameTable
+{
+    static constexpr size_t BUCKETS = N / 2 + 1;
+    static constexpr size_t SLOTS = bit_ceil(2 * N);
+    array<uint16_t, BUCKETS> displacement{};
+    array<NameValue, SLOTS> slots{};
+
+    // Entry for `name` (its spelling as listed), or nullptr
+    constexpr const NameValue *lookup(string_view name) const
+    {
+        uint32_t h = nameHash(name);
+        const NameValue &e = slots[displacedSlot(h, displacement[h % BUCKETS]) & (SLOTS - 1)];
+        return !e.name.empty() && iequals(e.name, name) ? &e : nullptr;
+    }
+
+    // Value of `name`, or `missing`
+    constexpr int find(string_view name, int missing = -1) const
+    {
+        const NameValue *e = lookup(name);
+        return e ? e->value : missing;
+    }
+};
+
+template <size_t N>
+constexpr NameTable<N> makeNameTable(const NameValue (&names)[N])
+{
+    using Table = NameTable<N>;
+    Table t;
+    // Names grouped by bucket (a counting sort on the first-level hash)
+    array<uint32_t, N> hashes{};
+    array<size_t, Table::BUCKETS + 1> start{};
+    for (size_t i = 0; i < N; ++i)
+    {
+        hashes[i] = nameHash(names[i].name);
+        ++start[hashes[i] % Table::BUCKETS + 1];
+    }
+    for (size_t b = 0; b < Table::BUCKETS; ++b)
+        start[b + 1] += start[b];
+    array<size_t, N> members{};
+    array<size_t, Table::BUCKETS> fill{};
+    for (size_t i = 0; i < N; ++i)
+    {
+        size_t b = hashes[i] % Table::BUCKETS;
+        members[start[b] + fill[b]++] = i;
+    }
+
+    // Fullest buckets first, while most slots are still free
+    array<size_t, N> placed{};
+    size_t largest = *max_element(fill.begin(), fill.end());
+    for (size_t size = largest; size > 0; --size)
+        for (size_t b = 0; b < Table::BUCKETS; ++b)
+        {
+            if (fill[b] != size)
+                continue;
+            for (uint32_t d = 0;; ++d)
+            {
+                if (d > 0xFFFF)
+                    throw "duplicate name in a NameTable"; // not a constant expression: fails the build
+                size_t n = 0;
+                for (; n < size; ++n)
+                {
+                    size_t i = members[start[b] + n];
+                    size_t slot = displacedSlot(hashes[i], d) & (Table::SLOTS - 1);
+                    if (!t.slots[slot].name.empty())
+                        break;
+                    t.slots[slot] = names[i];
+                    placed[n] = slot;
+                }
+                if (n == size)
+                {
+                    t.displacement[b] = (uint16_t)d;
+                    break;
+                }
+                for (size_t k = 0; k < n; ++k)
+                    t.slots[placed[k]] = {};
+            }
+        }
+    return t;
+}
+
+// ------------------------------------------
+// Register names (xN and ABI)
+// ------------------------------------------
+static constexpr NameValue REG_NAMES[] = {
+    {"x0", 0}, {"x1", 1}, {"x2", 2}, {"x3", 3}, {"x4", 4}, {"x5", 5}, {"x6", 6}, {"x7", 7},
+    {"x8", 8}, {"x9", 9}, {"x10", 10}, {"x11", 11}, {"x12", 12}, {"x13", 13}, {"x14", 14}, {"x15", 15},
+    {"x16", 16}, {"x17", 17}, {"x18", 18}, {"x19", 19}, {"x20", 20}, {"x21", 21}, {"x22", 22}, {"x23", 23},
+    {"x24", 24}, {"x25", 25}, {"x26", 26}, {"x27", 27}, {"x28", 28}, {"x29", 29}, {"x30", 30}, {"x31", 31},
+
+    // Zero & return
+    {"zero", 0},
+    {"ra", 1},
+    {"sp", 2},
+    {"gp", 3},
+    {"tp", 4},
+
+    // Temporaries
+    {"t0", 5},
+    {"t1", 6},
+    {"t2", 7},
+    {"t3", 28},
+    {"t4", 29},
+    {"t5", 30},
+    {"t6", 31},
+
+    // Saved registers
+    {"s0", 8},
+    {"s1", 9},
+    {"s2", 18},
+    {"s3", 19},
+    {"s4", 20},
+    {"s5", 21},
+    {"s6", 22},
+    {"s7", 23},
+    {"s8", 24},
+    {"s9", 25},
+    {"s10", 26},
+    {"s11", 27},
+
+    // Arguments / return values
+    {"a0", 10},
+    {"a1", 11},
+    {"a2", 12},
+    {"a3", 13},
+    {"a4", 14},
+    {"a5", 15},
+    {"a6", 16},
+    {"a7", 17}};
+static constexpr auto REG_NAME_TABLE = makeNameTable(REG_NAMES);
+
+// ------------------------------------------
+// CSR Name Map (Zicntr user counters)
+// ------------------------------------------
+enum CsrAddr : int
+{
+    CSR_CYCLE = 0xC00,
+    CSR_TIME = 0xC01,
+    CSR_INSTRET = 0xC02,
+    CSR_CYCLEH = 0xC80,
+    CSR_TIMEH = 0xC81,
+    CSR_INSTRETH = 0xC82,
+};
+
+static constexpr NameValue CSR_NAMES[] = {
+    {"cycle", CSR_CYCLE},
+    {"time", CSR_TIME},
+    {"instret", CSR_INSTRET},
+    {"cycleh", CSR_CYCLEH},
+    {"timeh", CSR_TIMEH},
+    {"instreth", CSR_INSTRETH}};
+static constexpr auto CSR_NAME_TABLE = makeNameTable(CSR_NAMES);
+
+//-------------------------------------
+// Opcode table (binary encodings)
+//-------------------------------------
+// Operand layout of each instruction, used to decode and to print it.
+enum class Fmt : uint8_t
+{
+    R,      // rd, rs1, rs2
+    I,      // rd, rs1, imm
+    L,      // rd, imm(rs1)        loads, JALR
+    S,      // rs2, imm(rs1)
+    B,      // rs1, rs2, offset
+    U,      // rd, imm[31:12]
+    J,      // rd, offset
+    SHIFT,  // rd, rs1, shamt      selector = funct6
+    SHIFTW, // rd, rs1, shamt      selector = funct7
+    AMO,    // rd, rs2, (rs1)      selector = funct5
+    CSR,    // rd, csr, rs1
+    CSRI,   // rd, csr, uimm
+    SYS,    // (none)              selector = imm[11:0]
+};
+
+// X(enum, mnemonic, format, opcode, funct3 (-1 = any), selector, RV64-only)
+#define RV_OPS(X)                                    \
+    X(LUI, "LUI", U, 0x37, -1, 0, 0)                 \
+    X(AUIPC, "AUIPC", U, 0x17, -1, 0, 0)             \
+    X(JAL, "JAL", J, 0x6F, -1, 0, 0)                 \
+    X(JALR, "JALR", L, 0x67, 0, 0, 0)                \
+    X(BEQ, "BEQ", B, 0x63, 0, 0, 0)                  \
+    X(BNE, "BNE", B, 0x63, 1, 0, 0)                  \
+    X(BLT, "BLT", B, 0x63, 4, 0, 0)                  \
+    X(BGE, "BGE", B, 0x63, 5, 0, 0)                  \
+    X(BLTU, "BLTU", B, 0x63, 6, 0, 0)                \
+    X(BGEU, "BGEU", B, 0x63, 7, 0, 0)                \
+    X(LB, "LB", L, 0x03, 0, 0, 0)                    \
+    X(LH, "LH", L, 0x03, 1, 0, 0)                    \
+    X(LW, "LW", L, 0x03, 2, 0, 0)                    \
+    X(LD, "LD", L, 0x03, 3, 0, 1)                    \
+    X(LBU, "LBU", L, 0x03, 4, 0, 0)                  \
+    X(LHU, "LHU", L, 0x03, 5, 0, 0)                  \
+    X(LWU, "LWU", L, 0x03, 6, 0, 1)                  \
+    X(SB, "SB", S, 0x23, 0, 0, 0)                    \
+    X(SH, "SH", S, 0x23, 1, 0, 0)                    \
+    X(SW, "SW", S, 0x23, 2, 0, 0)                    \
+    X(SD, "SD", S, 0x23, 3, 0, 1)                    \
+    X(ADDI, "ADDI", I, 0x13, 0, 0, 0)                \
+    X(SLTI, "SLTI", I, 0x13, 2, 0, 0)                \
+    X(SLTIU, "SLTIU", I, 0x13, 3, 0, 0)              \
+    X(XORI, "XORI", I, 0x13, 4, 0, 0)                \
+    X(ORI, "ORI", I, 0x13, 6, 0, 0)                  \
+    X(ANDI, "ANDI", I, 0x13, 7, 0, 0)                \
+    X(SLLI, "SLLI", SHIFT, 0x13, 1, 0x00, 0)         \
+    X(SRLI, "SRLI", SHIFT, 0x13, 5, 0x00, 0)         \
+    X(SRAI, "SRAI", SHIFT, 0x13, 5, 0x10, 0)         \
+    X(ADD, "ADD", R, 0x33, 0, 0x00, 0)               \
+    X(SUB, "SUB", R, 0x33, 0, 0x20, 0)               \
+    X(SLL, "SLL", R, 0x33, 1, 0x00, 0)               \
+    X(SLT, "SLT", R, 0x33, 2, 0x00, 0)               \
+    X(SLTU, "SLTU", R, 0x33, 3, 0x00, 0)             \
+    X(XOR, "XOR", R, 0x33, 4, 0x00, 0)               \
+    X(SRL, "SRL", R, 0x33, 5, 0x00, 0)               \
+    X(SRA, "SRA", R, 0x33, 5, 0x20, 0)               \
+    X(OR, "OR", R, 0x33, 6, 0x00, 0)                 \
+    X(AND, "AND", R, 0x33, 7, 0x00, 0)               \
+    X(MUL, "MUL", R, 0x33, 0, 0x01, 0)               \
+    X(MULH, "MULH", R, 0x33, 1, 0x01, 0)             \
+    X(MULHSU, "MULHSU", R, 0x33, 2, 0x01, 0)         \
+    X(MULHU, "MULHU", R, 0x33, 3, 0x01, 0)           \
+    X(DIV, "DIV", R, 0x33, 4, 0x01, 0)               \
+    X(DIVU, "DIVU", R, 0x33, 5, 0x01, 0)             \
+    X(REM, "REM", R, 0x33, 6, 0x01, 0)               \
+    X(REMU, "REMU", R, 0x33, 7, 0x01, 0)             \
+    X(ADDIW, "ADDIW", I, 0x1B, 0, 0, 1)              \
+    X(SLLIW, "SLLIW", SHIFTW, 0x1B, 1, 0x00, 1)      \
+    X(SRLIW, "SRLIW", SHIFTW, 0x1B, 5, 0x00, 1)      \
+    X(SRAIW, "SRAIW", SHIFTW, 0x1B, 5, 0x20, 1)      \
+    X(ADDW, "ADDW", R, 0x3B, 0, 0x00, 1)             \
+    X(SUBW, "SUBW", R, 0x3B, 0, 0x20, 1)             \
+    X(SLLW, "SLLW", R, 0x3B, 1, 0x00, 1)             \
+    X(SRLW, "SRLW", R, 0x3B, 5, 0x00, 1)             \
+    X(SRAW, "SRAW", R, 0x3B, 5, 0x20, 1)             \
+    X(MULW, "MULW", R, 0x3B, 0, 0x01, 1)             \
+    X(DIVW, "DIVW", R, 0x3B, 4, 0x01, 1)             \
+    X(DIVUW, "DIVUW", R, 0x3B, 5, 0x01, 1)           \
+    X(REMW, "REMW", R, 0x3B, 6, 0x01, 1)             \
+    X(REMUW, "REMUW", R, 0x3B, 7, 0x01, 1)           \
+    X(FENCE, "FENCE", SYS, 0x0F, 0, 0, 0)            \
+    X(ECALL, "ECALL", SYS, 0x73, 0, 0x000, 0)        \
+    X(EBREAK, "EBREAK", SYS, 0x73, 0, 0x001, 0)      \
+    X(CSRRW, "CSRRW", CSR, 0x73, 1, 0, 0)            \
+    X(CSRRS, "CSRRS", CSR, 0x73, 2, 0, 0)            \
+    X(CSRRC, "CSRRC", CSR, 0x73, 3, 0, 0)            \
+    X(CSRRWI, "CSRRWI", CSRI, 0x73, 5, 0, 0)         \
+    X(CSRRSI, "CSRRSI", CSRI, 0x73, 6, 0, 0)         \
+    X(CSRRCI, "CSRRCI", CSRI, 0x73, 7, 0, 0)         \
+    X(LR_W, "LR.W", AMO, 0x2F, 2, 0x02, 0)           \
+    X(SC_W, "SC.W", AMO, 0x2F, 2, 0x03, 0)           \
+    X(AMOSWAP_W, "AMOSWAP.W", AMO, 0x2F, 2, 0x01, 0) \
+    X(AMOADD_W, "AMOADD.W", AMO, 0x2F, 2, 0x00, 0)   \
+    X(AMOXOR_W, "AMOXOR.W", AMO, 0x2F, 2, 0x04, 0)   \
+    X(AMOAND_W, "AMOAND.W", AMO, 0x2F, 2, 0x0C, 0)   \
+    X(AMOOR_W, "AMOOR.W", AMO, 0x2F, 2, 0x08, 0)     \
+    X(AMOMIN_W, "AMOMIN.W", AMO, 0x2F, 2, 0x10, 0)   \
+    X(AMOMAX_W, "AMOMAX.W", AMO, 0x2F, 2, 0x14, 0)   \
+    X(AMOMINU_W, "AMOMINU.W", AMO, 0x2F, 2, 0x18, 0) \
+    X(AMOMAXU_W, "AMOMAXU.W", AMO, 0x2F, 2, 0x1C, 0) \
+    X(LR_D, "LR.D", AMO, 0x2F, 3, 0x02, 1)           \
+    X(SC_D, "SC.D", AMO, 0x2F, 3, 0x03, 1)           \
+    X(AMOSWAP_D, "AMOSWAP.D", AMO, 0x2F, 3, 0x01, 1) \
+    X(AMOADD_D, "AMOADD.D", AMO, 0x2F, 3, 0x00, 1)   \
+    X(AMOXOR_D, "AMOXOR.D", AMO, 0x2F, 3, 0x04, 1)   \
+    X(AMOAND_D, "AMOAND.D", AMO, 0x2F, 3, 0x0C, 1)   \
+    X(AMOOR_D, "AMOOR.D", AMO, 0x2F, 3, 0x08, 1)     \
+    X(AMOMIN_D, "AMOMIN.D", AMO, 0x2F, 3, 0x10, 1)   \
+    X(AMOMAX_D, "AMOMAX.D", AMO, 0x2F, 3, 0x14, 1)   \
+    X(AMOMINU_D, "AMOMINU.D", AMO, 0x2F, 3, 0x18, 1) \
+    X(AMOMAXU_D, "AMOMAXU.D", AMO, 0x2F, 3, 0x1C, 1)
+
+// NONE marks an empty decode-cache slot; ILLEGAL a word that failed to decode
+enum class Op : uint8_t
+{
+    NONE,
+    ILLEGAL,
+#define X(id, name, fmt, opcode, funct3, sel, rv64) id,
+    RV_OPS(X)
+#undef X
+        COUNT
+};
+
+struct OpInfo
+{
+    const char *name;
+    Fmt fmt;
+    uint8_t opcode;
+    int8_t funct3;
+    uint16_t sel;
+    bool rv64;
+};
+
+static constexpr OpInfo OP_INFO[] = {
+    {"<none>", Fmt::SYS, 0, -1, 0, false},
+    {"<illegal>", Fmt::SYS, 0, -1, 0, false},
+#define X(id, name, fmt, opcode, funct3, sel, rv64) {name, Fmt::fmt, opcode, funct3, sel, rv64},
+    RV_OPS(X)
+#undef X
+};
+static_assert(size(OP_INFO) == (size_t)Op::COUNT, "OP_INFO out of sync with Op");
+
+inline const OpInfo &opInfo(Op op) { return OP_INFO[(size_t)op]; }
+
+static constexpr NameValue OP_NAMES[] = {
+#define X(id, name, fmt, opcode, funct3, sel, rv64) {name, (int)Op::id},
+    RV_OPS(X)
+#undef X
+};
+static constexpr auto OP_NAME_TABLE = makeNameTable(OP_NAMES);
+
+// Mnemonic → Op for the text front end
+constexpr Op opByName(string_view name) { return (Op)OP_NAME_TABLE.find(name, (int)Op::ILLEGAL); }
+
+// Coarse instruction classes for the opcode-mix report. Branches are split
+// by outcome, so a branch's class is only known once it has executed.
+enum class InstClass : uint8_t
+{
+    ALU,    // register/immediate arithmetic, shifts, LUI/AUIPC, M extension
+    LOAD,
+    STORE,
+    BRANCH_TAKEN,
+    BRANCH_NOT_TAKEN,
+    JUMP,   // JAL, JALR
+    ATOMIC, // A extension, LR/SC included
+    SYSTEM, // Zicsr, FENCE, ECALL, EBREAK
+    COUNT,
+};
+
+static constexpr const char *INST_CLASS_NAMES[] = {
+    "alu", "load", "store", "branch_taken", "branch_not_taken", "jump", "atomic", "system",
+};
+static_assert(size(INST_CLASS_NAMES) == (size_t)InstClass::COUNT, "INST_CLASS_NAMES out of sync with InstClass");
+
+// Class of an executed op; branches report BRANCH_TAKEN here
+inline InstClass instClass(Op op)
+{
+    if (op == Op::JALR)
+        return InstClass::JUMP;
+    switch (opInfo(op).fmt)
+    {
+    case Fmt::L:
+        return InstClass::LOAD;
+    case Fmt::S:
+        return InstClass::STORE;
+    case Fmt::B:
+        return InstClass::BRANCH_TAKEN;
+    case Fmt::J:
+        return InstClass::JUMP;
+    case Fmt::AMO:
+        return InstClass::ATOMIC;
+    case Fmt::CSR:
+    case Fmt::CSRI:
+    case Fmt::SYS:
+        return InstClass::SYSTEM;
+    default:
+        return InstClass::ALU;
+    }
+}
+
+// Decoded form of one instruction word
+struct DecodedInst
+{
+    Op op = Op::NONE;
+    uint8_t rd = 0;
+    uint8_t rs1 = 0; // also the 5-bit uimm of CSR*I
+    uint8_t rs2 = 0;
+    int32_t imm = 0; // sign-extended; shamt for shifts, CSR number for Zicsr
+};
+
+// Timing models see each instruction after it executes and keep their own
+// notion of time; execution never depends on them. The core holds at most
+// one (RiscvCore::timing) and skips the hook entirely when none is attached.
+// riscv_pipeline.h has a 5-stage in-order pipeline.
+struct TimingModel
+{
+    virtual ~TimingModel() = default;
+    // redirect: control left the fall-through path (taken branch, jump)
+    virtual void retire(const DecodedInst &d, bool redirect) = 0;
+    // A program was loaded or the core reset
+    virtual void reset() = 0;
+    // Cycles taken by the instructions retired so far (the cycle CSR)
+    virtual uint64_t cycleCount() const = 0;
+};
+
+//-------------------------------------
+// Table-driven decoder
+//-------------------------------------
+// Candidates for each (opcode[6:2], funct3) pair; most slots hold exactly
+// one op, the rest are told apart by the format's selector field.
+struct DecodeTables
+{
+    struct Slot
+    {
+        uint8_t first = 0;
+        uint8_t count = 0;
+    };
+    array<Slot, 32 * 8> slots{};
+    array<Op, 256> candidates{};
+};
+
+static constexpr DecodeTables buildDecodeTables()
+{
+    DecodeTables t{};
+    size_t n = 0;
+    for (int key = 0; key < 32 * 8; ++key)
+    {
+        t.slots[key].first = (uint8_t)n;
+        for (size_t i = (size_t)Op::ILLEGAL + 1; i < (size_t)Op::COUNT; ++i)
+        {
+            const OpInfo &info = OP_INFO[i];
+            if ((info.opcode >> 2) == (key >> 3) && (info.funct3 < 0 || info.funct3 == (key & 7)))
+                t.candidates[n++] = (Op)i;
+        }
+        t.slots[key].count = (uint8_t)(n - t.slots[key].first);
+    }
+    return t;
+}
+
+static constexpr DecodeTables DECODE_TABLES = buildDecodeTables();
+
+template <int XLEN>
+DecodedInst decodeWord(uint32_t w)
+{
+    DecodedInst d;
+    d.op = Op::ILLEGAL;
+    if ((w & 3) != 3) // compressed (RVC) encodings are not supported
+        return d;
+
+    const auto &slot = DECODE_TABLES.slots[((w >> 2) & 0x1F) * 8 + ((w >> 12) & 7)];
+    for (int i = 0; i < slot.count; ++i)
+    {
+        Op op = DECODE_TABLES.candidates[slot.first + i];
+        const OpInfo &info = opInfo(op);
+        uint32_t sel;
+        switch (info.fmt)
+        {
+        case Fmt::R:
+        case Fmt::SHIFTW:
+            sel = w >> 25;
+            break;
+        case Fmt::SHIFT:
+            sel = w >> 26;
+            break;
+        case Fmt::AMO:
+            sel = w >> 27;
+            break;
+        case Fmt::SYS:
+            sel = info.opcode == 0x73 ? w >> 20 : 0;
+            break;
+        default:
+            sel = 0;
+            break;
+        }
+        if (sel != info.sel || (XLEN == 32 && info.rv64))
+            continue;
+        // RV32 shift amounts are 5 bits; shamt[5] set is reserved
+        if (XLEN == 32 && info.fmt == Fmt::SHIFT && (w >> 25) & 1)
+            return d;
+        d.op = op;
+        break;
+    }
+    if (d.op == Op::ILLEGAL)
+        return d;
+
+    d.rd = (w >> 7) & 0x1F;
+    d.rs1 = (w >> 15) & 0x1F;
+    d.rs2 = (w >> 20) & 0x1F;
+
+    switch (opInfo(d.op).fmt)
+    {
+    case Fmt::I:
+    case Fmt::L:
+        d.imm = (int32_t)w >> 20;
+        break;
+    case Fmt::S:
+        d.imm = (((int32_t)w >> 25) << 5) | ((w >> 7) & 0x1F);
+        break;
+    case Fmt::B:
+        d.imm = (((int32_t)w >> 31) << 12) | ((w << 4) & 0x800) |
+                ((w >> 20) & 0x7E0) | ((w >> 7) & 0x1E);
+        break;
+    case Fmt::U:
+        d.imm = (int32_t)(w & 0xFFFFF000);
+        break;
+    case Fmt::J:
+        d.imm = (((int32_t)w >> 31) << 20) | (w & 0xFF000) |
+                ((w >> 9) & 0x800) | ((w >> 20) & 0x7FE);
+        break;
+    case Fmt::SHIFT:
+        d.imm = (w >> 20) & (XLEN - 1);
+        break;
+    case Fmt::SHIFTW:
+        d.imm = (w >> 20) & 0x1F;
+        break;
+    case Fmt::CSR:
+    case Fmt::CSRI:
+        d.imm = (w >> 20) & 0xFFF;
+        break;
+    case Fmt::AMO:
+        d.imm = (w >> 25) & 3; // aq/rl
+        break;
+    case Fmt::SYS:
+        d.imm = d.op == Op::FENCE ? (w >> 20) & 0xFFF : 0;
+        break;
+    default:
+        break;
+    }
+    return d;
+}
+
+//-------------------------------------
+// Encoder (inverse of decodeWord)
+//-------------------------------------
+inline uint32_t encodeWord(const DecodedInst &d)
+{
+    const OpInfo &info = opInfo(d.op);
+    const uint32_t imm = (uint32_t)d.imm;
+    const uint32_t rd = (uint32_t)d.rd << 7, rs1 = (uint32_t)d.rs1 << 15, rs2 = (uint32_t)d.rs2 << 20;
+    const uint32_t w = info.opcode | (uint32_t)(info.funct3 < 0 ? 0 : info.funct3) << 12;
+
+    switch (info.fmt)
+    {
+    case Fmt::R:
+        return w | rd | rs1 | rs2 | (uint32_t)info.sel << 25;
+    case Fmt::I:
+    case Fmt::L:
+        return w | rd | rs1 | (imm & 0xFFF) << 20;
+    case Fmt::S:
+        return w | rs1 | rs2 | (imm & 0xFE0) << 20 | (imm & 0x1F) << 7;
+    case Fmt::B:
+        return w | rs1 | rs2 | (imm & 0x1000) << 19 | (imm & 0x7E0) << 20 |
+               (imm & 0x1E) << 7 | (imm & 0x800) >> 4;
+    case Fmt::U:
+        return w | rd | (imm & 0xFFFFF000);
+    case Fmt::J:
+        return w | rd | (imm & 0x100000) << 11 | (imm & 0x7FE) << 20 |
+               (imm & 0x800) << 9 | (imm & 0xFF000);
+    case Fmt::SHIFT:
+        return w | rd | rs1 | (imm & 0x3F) << 20 | (uint32_t)info.sel << 26;
+    case Fmt::SHIFTW:
+        return w | rd | rs1 | (imm & 0x1F) << 20 | (uint32_t)info.sel << 25;
+    case Fmt::AMO:
+        return w | rd | rs1 | rs2 | (imm & 3) << 25 | (uint32_t)info.sel << 27;
+    case Fmt::CSR:
+    case Fmt::CSRI:
+        return w | rd | rs1 | (imm & 0xFFF) << 20;
+    case Fmt::SYS:
+        return w | ((uint32_t)info.sel | (imm & 0xFFF)) << 20;
+    }
+    return 0;
+}
+
+//-------------------------------------
+// Disassembler
+//-------------------------------------
+// Table-driven text for decoded records and raw words, written into caller
+// buffers: numbers go through digit lookup tables rather than iostreams and
+// nothing allocates, so tracing every executed instruction stays cheap.
+// Output is at most DISASM_MAX bytes, not NUL-terminated.
+static constexpr size_t DISASM_MAX = 64;
+
+struct DigitPairs
+{
+    char text[200]; // "00" .. "99"
+};
+static constexpr DigitPairs DIGIT_PAIRS = []
+{
+    DigitPairs t{};
+    for (int i = 0; i < 100; ++i)
+    {
+        t.text[2 * i] = (char)('0' + i / 10);
+        t.text[2 * i + 1] = (char)('0' + i % 10);
+    }
+    return t;
+}();
+static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+inline char *putText(char *p, string_view s)
+{
+    memcpy(p, s.data(), s.size());
+    return p + s.size();
+}
+
+inline char *putDec(char *p, int64_t v)
+{
+    uint64_t u = (uint64_t)v;
+    if (v < 0)
+    {
+        *p++ = '-';
+        u = 0 - u;
+    }
+    char tmp[20];
+    char *t = tmp + sizeof(tmp);
+    for (; u >= 100; u /= 100)
+        memcpy(t -= 2, &DIGIT_PAIRS.text[2 * (u % 100)], 2);
+    if (u >= 10)
+        memcpy(t -= 2, &DIGIT_PAIRS.text[2 * u], 2);
+    else
+        *--t = (char)('0' + u);
+    return putText(p, {t, (size_t)(tmp + sizeof(tmp) - t)});
+}
+
+// `digits` lower-case hex digits, zero-padded
+inline char *putHex(char *p, uint64_t v, int digits)
+{
+    for (int i = digits - 1; i >= 0; --i, v >>= 4)
+        p[i] = HEX_DIGITS[v & 0xF];
+    return p + digits;
+}
+
+// REG_NAMES starts with x0..x31
+inline char *putReg(char *p, int r) { return putText(p, REG_NAMES[r].name); }
+
+// Operand layout of each format, in assembler order
+enum class Operand : uint8_t
+{
+    RD,
+    RS1,
+    RS2,
+    IMM,   // signed decimal
+    UPPER, // imm[31:12]
+    MEM,   // imm(rs1)
+    ADDR,  // (rs1)
+    CSR,   // CSR number
+    UIMM,  // rs1 field as a 5-bit immediate
+};
+
+struct OperandLayout
+{
+    uint8_t count;
+    Operand items[3];
+};
+
+static constexpr OperandLayout FMT_OPERANDS[] = {
+    {3, {Operand::RD, Operand::RS1, Operand::RS2}},  // R
+    {3, {Operand::RD, Operand::RS1, Operand::IMM}},  // I
+    {2, {Operand::RD, Operand::MEM}},                // L
+    {2, {Operand::RS2, Operand::MEM}},               // S
+    {3, {Operand::RS1, Operand::RS2, Operand::IMM}}, // B
+    {2, {Operand::RD, Operand::UPPER}},              // U
+    {2, {Operand::RD, Operand::IMM}},                // J
+    {3, {Operand::RD, Operand::RS1, Operand::IMM}},  // SHIFT
+    {3, {Operand::RD, Operand::RS1, Operand::IMM}},  // SHIFTW
+    {3, {Operand::RD, Operand::RS2, Operand::ADDR}}, // AMO
+    {3, {Operand::RD, Operand::CSR, Operand::RS1}},  // CSR
+    {3, {Operand::RD, Operand::CSR, Operand::UIMM}}, // CSRI
+    {0, {}},                                         // SYS
+};
+static_assert(size(FMT_OPERANDS) == (size_t)Fmt::SYS + 1, "FMT_OPERANDS out of sync with Fmt");
+static constexpr OperandLayout LR_OPERANDS = {2, {Operand::RD, Operand::ADDR}};
+
+// "ADDI x1, x2, -5"; returns the length written
+inline size_t disassemble(const DecodedInst &d, char *out)
+{
+    const OpInfo &info = opInfo(d.op);
+    const OperandLayout &layout = d.op == Op::LR_W || d.op == Op::LR_D ? LR_OPERANDS : FMT_OPERANDS[(size_t)info.fmt];
+    char *p = putText(out, info.name);
+    for (int i = 0; i < layout.count; ++i)
+    {
+        p = putText(p, i ? ", " : " ");
+        switch (layout.items[i])
+        {
+        case Operand::RD:
+            p = putReg(p, d.rd);
+            break;
+        case Operand::RS1:
+            p = putReg(p, d.rs1);
+            break;
+        case Operand::RS2:
+            p = putReg(p, d.rs2);
+            break;
+        case Operand::IMM:
+        case Operand::CSR:
+            p = putDec(p, d.imm);
+            break;
+        case Operand::UPPER:
+            p = putDec(p, (uint32_t)d.imm >> 12);
+            break;
+        case Operand::MEM:
+            p = putDec(p, d.imm);
+            *p++ = '(';
+            p = putReg(p, d.rs1);
+            *p++ = ')';
+            break;
+        case Operand::ADDR:
+            *p++ = '(';
+            p = putReg(p, d.rs1);
+            *p++ = ')';
+            break;
+        case Operand::UIMM:
+            p = putDec(p, d.rs1);
+            break;
+        }
+    }
+    return p - out;
+}
+
+// A raw word; one that does not decode prints as ".word 0x........"
+template <int XLEN>
+size_t disassembleWord(uint32_t w, char *out)
+{
+    DecodedInst d = decodeWord<XLEN>(w);
+    if (d.op != Op::ILLEGAL)
+        return disassemble(d, out);
+    char *p = putText(out, ".word 0x");
+    return putHex(p, w, 8) - out;
+}
+
+//-------------------------------------
+// Execution events
+//-------------------------------------
+// The core reports what happens while it runs as fixed-size binary records
+// in a ring (RiscvCore::drainEvents) rather than console text; text is
+// made by formatEvent() only for the records that get displayed.
+enum class EventKind : uint8_t
+{
+    EXEC,       // instruction about to execute; a = its DecodedInst
+    BRANCH,     // conditional branch resolved; detail = taken, a = next PC
+    FAULT,      // detail = FaultKind
+    MISALIGNED, // a = address, detail = required alignment
+    HALT,       // detail = HaltCause
+    LOST,       // the ring overflowed; a = events dropped before this one
+};
+
+enum class FaultKind : uint8_t
+{
+    ILLEGAL,      // a = instruction word
+    BOUNDS,       // a = address, b = last valid byte address
+    CSR,          // unsupported CSR; a = CSR number
+    CSR_READONLY, // a = CSR number
+};
+
+enum class HaltCause : uint8_t
+{
+    ECALL,
+    EBREAK,
+    PC_RANGE,
+};
+
+// 32 bytes at fixed offsets, read from the heap by the UI
+struct Event
+{
+    EventKind kind;
+    uint8_t detail;
+    uint16_t op;  // Op at pc
+    int32_t line; // source line of pc, -1 if none
+    int64_t pc;
+    uint64_t a, b;
+};
+static_assert(sizeof(Event) == 32 && is_standard_layout_v<Event>);
+
+static constexpr size_t EVENT_TEXT_MAX = DISASM_MAX + 64;
+
+// Lower-case hex without leading zeros
+inline char *putHexMin(char *p, uint64_t v)
+{
+    return putHex(p, v, v ? (bit_width(v) + 3) / 4 : 1);
+}
+
+// Console line for an event, without the newline, into `out`
+// (EVENT_TEXT_MAX bytes); returns the length
+inline size_t formatEvent(const Event &e, char *out)
+{
+    const char *name = opInfo((Op)e.op).name;
+    char *p = out;
+    switch (e.kind)
+    {
+    case EventKind::EXEC:
+    {
+        p = putText(p, "[Exec] ");
+        p += disassemble(bit_cast<DecodedInst>(e.a), p);
+        p = putText(p, " (PC=");
+        p = putDec(p, e.pc);
+        p = putText(p, ", Line=");
+        p = putDec(p, e.line);
+        p = putText(p, ")");
+        break;
+    }
+    case EventKind::BRANCH:
+        p = putText(putText(p, "[RISC-V] "), name);
+        p = putText(p, e.detail ? " taken → PC=" : " not taken → next PC=");
+        p = putDec(p, (int64_t)e.a);
+        break;
+    case EventKind::FAULT:
+        switch ((FaultKind)e.detail)
+        {
+        case FaultKind::ILLEGAL:
+            p = putHexMin(putText(p, "[Warning] Illegal instruction 0x"), e.a);
+            p = putHexMin(putText(p, " at PC=0x"), e.pc);
+            break;
+        case FaultKind::BOUNDS:
+            p = putHexMin(putText(p, "[Warning] Memory access OOB at 0x"), e.a);
+            p = putDec(putText(p, " (valid 0.."), e.b);
+            p = putText(p, ")");
+            break;
+        case FaultKind::CSR:
+            p = putHexMin(putText(p, "[Warning] Unsupported CSR 0x"), e.a);
+            break;
+        case FaultKind::CSR_READONLY:
+            p = putHexMin(putText(p, "[Warning] Write to read-only CSR 0x"), e.a);
+            break;
+        }
+        break;
+    case EventKind::MISALIGNED:
+        p = putText(putText(p, "[Warning] Misaligned "), name);
+        p = putHexMin(putText(p, " at 0x"), e.a);
+        p = putDec(putText(p, " (align "), e.detail);
+        p = putText(p, ")");
+        break;
+    case EventKind::HALT:
+        p = putText(p, e.detail == (uint8_t)HaltCause::ECALL    ? "[RISC-V] ECALL — program halted."
+                       : e.detail == (uint8_t)HaltCause::EBREAK ? "[RISC-V] EBREAK — program halted."
+                                                                : "[RISC-V] PC out of range — halting.");
+        break;
+    case EventKind::LOST:
+        p = putDec(putText(p, "[RISC-V] "), e.a);
+        p = putText(p, " earlier events dropped.");
+        break;
+    }
+    return p - out;
+}
+
+//-------------------------------------
+// Register width (XLEN)
+//-------------------------------------
+template <int XLEN>
+struct XlenTraits;
+
+template <>
+struct XlenTraits<32>
+{
+    using sreg = int32_t;
+    using ureg = uint32_t;
+};
+
+template <>
+struct XlenTraits<64>
+{
+    using sreg = int64_t;
+    using ureg = uint64_t;
+};
+
+// Build width is fixed at compile time: -DRISCV_XLEN=64 for RV64I
+#ifndef RISCV_XLEN
+#define RISCV_XLEN 32
+#endif
+
+//-------------------------------------
+// ELF file layout (little-endian RISC-V)
+//-------------------------------------
+template <int XLEN>
+struct ElfTypes;
+
+template <>
+struct ElfTypes<32>
+{
+    struct Ehdr
+    {
+        uint8_t ident[16];
+        uint16_t type, machine;
+        uint32_t version, entry, phoff, shoff, flags;
+        uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+    };
+    struct Phdr
+    {
+        uint32_t type, offset, vaddr, paddr, filesz, memsz, flags, align;
+    };
+    struct Shdr
+    {
+        uint32_t name, type, flags, addr, offset, size, link, info, addralign, entsize;
+    };
+    struct Sym
+    {
+        uint32_t name, value, size;
+        uint8_t info, other;
+        uint16_t shndx;
+    };
+    static constexpr uint8_t ELF_CLASS = 1;
+};
+
+template <>
+struct ElfTypes<64>
+{
+    struct Ehdr
+    {
+        uint8_t ident[16];
+        uint16_t type, machine;
+        uint32_t version;
+        uint64_t entry, phoff, shoff;
+        uint32_t flags;
+        uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+    };
+    struct Phdr
+    {
+        uint32_t type, flags;
+        uint64_t offset, vaddr, paddr, filesz, memsz, align;
+    };
+    struct Shdr
+    {
+        uint32_t name, type;
+        uint64_t flags, addr, offset, size;
+        uint32_t link, info;
+        uint64_t addralign, entsize;
+    };
+    struct Sym
+    {
+        uint32_t name;
+        uint8_t info, other;
+        uint16_t shndx;
+        uint64_t value, size;
+    };
+    static constexpr uint8_t ELF_CLASS = 2;
+};
+
+enum : uint32_t
+{
+    ELF_ET_EXEC = 2,
+    ELF_EM_RISCV = 243,
+    ELF_PT_LOAD = 1,
+    ELF_SHT_SYMTAB = 2,
+    ELF_STT_FUNC = 2,
+};
+
+// Named address from an ELF symbol table, for profilers and tracing
+struct Symbol
+{
+    string name;
+    uint64_t addr = 0;
+    uint64_t size = 0;
+    bool isFunc = false;
+};
+
+// Transparent hash so labels can be looked up by string_view
+struct LabelHash
+{
+    using is_transparent = void;
+    size_t operator()(string_view s) const { return hash<string_view>{}(s); }
+};
+
+//-------------------------------------
+// RISC-V Emulator core
+//-------------------------------------
+template <int XLEN>
+class RiscvCore
+{
+public:
+    using sreg = typename XlenTraits<XLEN>::sreg;
+    using ureg = typename XlenTraits<XLEN>::ureg;
+
+    // Architectural registers in one fixed block (x0..x31, then pc), so
+    // the UI can map them as a typed array through getRegsPtr()
+    struct RegisterFile
+    {
+        sreg x[32];
+        sreg pc;
+    };
+    static_assert(is_standard_layout_v<RegisterFile> && sizeof(RegisterFile) == 33 * sizeof(sreg));
+
+    RegisterFile regs = {};
+    vector<uint8_t> memory; // byte-addressable memory (e.g., 4 KiB)
+    unordered_map<string, sreg, LabelHash, equal_to<>> labels;
+
+    // Assembled text goes above the 4 KiB data/stack region by default
+    static constexpr sreg DEFAULT_TEXT_BASE = 0x1000;
+    sreg textBase = DEFAULT_TEXT_BASE;
+    sreg dataBase = DEFAULT_TEXT_BASE;
+    vector<int> sourceLines; // source line of each assembled text word
+
+    // Assembler state kept for updateLines(). Statements and labels are
+    // views into sourceChunks, whose strings never move once added.
+    deque<string> sourceChunks;      // loaded text, then each edit's text
+    vector<string_view> sourceText;  // one view per source line
+    vector<uint8_t> lineSection;     // section at the start of each line, plus one past the end
+    vector<Instruction> program;     // statements in source order
+    vector<LabelDef> labelDefs;      // label definitions in source order
+    sreg requestedDataBase = -1;     // loadProgram's dataBase (-1: after .text)
+    uint32_t sectionSize[2] = {0, 0};
+    int assembleErrors = 0;          // errors reported by the last full assembly
+    sreg imageBase = DEFAULT_TEXT_BASE;
+    vector<uint8_t> image;           // assembled .text/.data as loaded
+
+    // Lazy assembly: loadProgram() only scans .text instructions for their
+    // size (which places the labels); each is parsed and encoded when its
+    // word is first fetched, loaded or stored; until then memory holds zeros.
+    bool lazyAssembly = false;
+    size_t pendingStatements = 0;
+
+    // Zicntr: instructions started since reset (the one in flight included)
+    uint64_t instret = 0;
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    // A extension: LR reservation (address and the value LR observed)
+    sreg reservationAddr = -1;
+    uint64_t reservationValue = 0;
+
+    // Programs run from guest memory through a per-word decode cache
+    vector<DecodedInst> decodeCache;
+
+    // Profiling: step() counts executions of each word in pcCounts,
+    // indexed by pc/4 like decodeCache. Off by default; see setProfiling().
+    bool profiling = false;
+    vector<uint64_t> pcCounts;
+    vector<uint64_t> takenCounts; // taken branches per word, same indexing
+
+    // Optional timing model, not owned; null for full-speed runs
+    TimingModel *timing = nullptr;
+
+    // Per-instruction events (EXEC, BRANCH); batch runs turn them off
+    bool traceExec = true;
+
+    // Events since the last drainEvents(); the ring keeps the newest
+    // EVENT_RING_SIZE
+    static constexpr size_t EVENT_RING_SIZE = 4096;
+    vector<Event> eventRing = vector<Event>(EVENT_RING_SIZE);
+    uint64_t eventsWritten = 0;
+    uint64_t eventsDrained = 0;
+    vector<Event> drainedEvents;
+
+    // Changes since the last consumeDelta(): registers whose value changed,
+    // and written memory as a bitmap with one bit per word. dirtyChunks
+    // lists the bitmap entries with any bit set, so consuming costs what was
+    // written rather than the memory size.
+    uint32_t dirtyRegs = 0;
+    bool deltaFull = true; // everything replaced since the last delta
+    vector<uint64_t> dirtyWords;
+    vector<uint32_t> dirtyChunks;
+    vector<uint32_t> deltaRecord;
+
+    // ELF symbols, sorted by address
+    vector<Symbol> symbols;
+
+    // Room reserved above the highest ELF segment for the initial stack
+    static constexpr size_t ELF_STACK_SIZE = 1 << 20;
+    // Guest memory is one flat array from address 0; refuse larger images
+    static constexpr size_t MAX_GUEST_MEMORY = 256u << 20;
+
+    RiscvCore()
+    {
+        memory.assign(4096, 0);
+        // Initialize stack pointer (x2 = sp) to end of memory
+        regs.x[2] = memory.size();     // top of 4 KB stack region
+        regs.x[3] = memory.size() / 2; // gp
+    }
+
+    //---------------------------------
+    // Program loading (two-pass assembler)
+    //---------------------------------
+    // Pass 1 (parseLines) parses each line once and expands
+    // pseudo-instructions; layout() places the .text and .data sections;
+    // pass 2 (encodeInto) writes real RV instruction words and data into the
+    // program image, which is copied into guest memory where step() fetches
+    // and decodes it. .text starts at `base`; .data at `dataAt`, or right
+    // after .text. With lazyAssembly set, pass 2 skips .text instructions,
+    // which assembleAt() finishes on demand.
+    void loadProgram(string source, sreg base = DEFAULT_TEXT_BASE, sreg dataAt = -1)
+    {
+        sourceChunks.clear();
+        sourceText.clear();
+        splitLines(sourceChunks.emplace_back(move(source)), sourceText);
+        textBase = base;
+        requestedDataBase = dataAt;
+        assemble();
+    }
+
+    // Incremental re-assembly: lines [first, first + removed) were replaced
+    // by `text` (one '\n' per line). Only the new lines are parsed; other
+    // statements keep their encoding and are re-encoded only when they refer
+    // to labels and either they or a label moved. Resets the CPU like
+    // loadProgram().
+    void updateLines(size_t first, size_t removed, string text)
+    {
+        first = min(first, sourceText.size());
+        removed = min(removed, sourceText.size() - first);
+
+        vector<string_view> lines;
+        splitLines(sourceChunks.emplace_back(move(text)), lines);
+        ptrdiff_t lineDelta = (ptrdiff_t)lines.size() - (ptrdiff_t)removed;
+        splice(sourceText, first, first + removed, lines);
+        if (lineSection.empty() || lazyAssembly)
+        {
+            // Loaded from the program cache: nothing parsed to patch yet.
+            // A lazy program is re-scanned, which costs about as much.
+            assemble();
+            return;
+        }
+
+        // ---- Pass 1 over the new lines only ----
+        vector<Instruction> stmts;
+        vector<LabelDef> defs;
+        vector<uint8_t> sections;
+        int errors = 0;
+        int endSection = parseLines(first, first + lines.size(), lineSection[first], stmts, defs, sections, errors);
+        if (endSection != lineSection[first + removed])
+        {
+            // A section switch changed the section of every later line
+            assemble();
+            return;
+        }
+
+        // ---- Splice statements, labels and line sections ----
+        auto byLine = [](const auto &x, size_t line)
+        { return (size_t)x.sourceLine < line; };
+        size_t s0 = lower_bound(program.begin(), program.end(), first, byLine) - program.begin();
+        size_t s1 = lower_bound(program.begin() + s0, program.end(), first + removed, byLine) - program.begin();
+        size_t d0 = lower_bound(labelDefs.begin(), labelDefs.end(), first, byLine) - labelDefs.begin();
+        size_t d1 = lower_bound(labelDefs.begin() + d0, labelDefs.end(), first + removed, byLine) - labelDefs.begin();
+
+        // Old addresses (-1 for new statements) decide what must move
+        vector<sreg> oldAddr(program.size());
+        for (size_t i = 0; i < program.size(); ++i)
+            oldAddr[i] = addressOf(program[i]);
+        for (size_t i = s0; i < s1; ++i)
+            fill_n(image.begin() + (oldAddr[i] - imageBase), program[i].size, 0);
+        splice(oldAddr, s0, s1, vector<sreg>(stmts.size(), -1));
+
+        bool sameLabels = d1 - d0 == defs.size() &&
+                          equal(defs.begin(), defs.end(), labelDefs.begin() + d0, [](const LabelDef &a, const LabelDef &b)
+                                { return a.name == b.name; });
+        if (!sameLabels)
+            for (size_t i = d0; i < d1; ++i)
+                if (auto it = labels.find(labelDefs[i].name); it != labels.end())
+                    labels.erase(it);
+
+        if (lineDelta)
+        {
+            for (size_t i = s1; i < program.size(); ++i)
+                program[i].sourceLine += lineDelta;
+            for (size_t i = d1; i < labelDefs.size(); ++i)
+                labelDefs[i].sourceLine += lineDelta;
+        }
+        splice(program, s0, s1, stmts);
+        splice(labelDefs, d0, d1, defs);
+        splice(lineSection, first, first + removed, sections);
+
+        // ---- Re-layout; moved bytes are copied, dependent ones re-encoded ----
+        sreg oldImageBase = imageBase;
+        bool labelsMoved = layout(errors) || !sameLabels;
+        size_t imageSize = imageEnd() - imageBase;
+        bool shifted = imageSize != image.size() || imageBase != oldImageBase;
+        for (size_t i = 0; i < program.size() && !shifted; ++i)
+            shifted = oldAddr[i] >= 0 && oldAddr[i] != addressOf(program[i]);
+
+        vector<uint8_t> oldImage;
+        if (shifted)
+        {
+            oldImage.swap(image);
+            image.assign(imageSize, 0);
+        }
+        size_t encoded = 0;
+        for (size_t i = 0; i < program.size(); ++i)
+        {
+            const Instruction &inst = program[i];
+            sreg at = addressOf(inst);
+            if (oldAddr[i] < 0 || ((labelsMoved || oldAddr[i] != at) && refersToLabels(inst)))
+            {
+                encodeInto(inst, errors);
+                ++encoded;
+            }
+            else if (shifted && !isAlignment(inst.op)) // padding may have resized
+                copy_n(oldImage.begin() + (oldAddr[i] - oldImageBase), inst.size, image.begin() + (at - imageBase));
+        }
+        mapSourceLines();
+        resetToImage();
+
+        cerr << "[RISC-V] Program updated at line " << first + 1 << " (" << removed << " lines replaced by "
+             << lines.size() << "), " << encoded << " statements encoded, " << labels.size() << " labels";
+        if (errors)
+            cerr << ", " << errors << " errors";
+        cerr << ".\n";
+    }
+
+    // Full assembly of sourceText
+    void assemble()
+    {
+        program.clear();
+        labelDefs.clear();
+        lineSection.clear();
+        labels.clear();
+        // at most one statement per line; growing by doubling costs more than the parse
+        program.reserve(sourceText.size());
+        lineSection.reserve(sourceText.size() + 1);
+
+        int errors = 0;
+        lineSection.push_back((uint8_t)parseLines(0, sourceText.size(), SECTION_TEXT, program, labelDefs, lineSection, errors));
+        layout(errors);
+        image.assign(imageEnd() - imageBase, 0);
+        pendingStatements = 0;
+        for (const auto &inst : program)
+        {
+            if (inst.pending)
+                ++pendingStatements;
+            else
+                encodeInto(inst, errors);
+        }
+        mapSourceLines();
+        resetToImage();
+        assembleErrors = errors;
+        logLoaded(lazyAssembly ? "Program scanned" : "Program loaded");
+    }
+
+    void logLoaded(const char *what) const
+    {
+        cerr << "[RISC-V] " << what << ": " << sectionSize[SECTION_TEXT] / 4 << " instructions at 0x"
+             << hex << textBase << dec;
+        if (sectionSize[SECTION_DATA])
+            cerr << ", " << sectionSize[SECTION_DATA] << " data bytes at 0x" << hex << dataBase << dec;
+        cerr << ", " << labels.size() << " labels";
+        if (assembleErrors)
+            cerr << ", " << assembleErrors << " errors";
+        cerr << ".\n";
+    }
+
+    //---------------------------------
+    // Compiled-program cache
+    //---------------------------------
+    // An assembled program (image, PC-to-line map, decoded text words and
+    // labels) as one binary blob, so a program seen before loads without
+    // parsing. Bump ASSEMBLER_VERSION whenever the assembler's output or
+    // this layout changes: it is part of every key.
+    static constexpr uint32_t ASSEMBLER_VERSION = 1;
+
+    struct CacheHeader
+    {
+        char magic[4]; // "RVPC"
+        uint32_t version;
+        uint32_t xlen;
+        uint32_t labelCount;
+        uint64_t key; // programCacheKey() of the source
+        int64_t textBase;
+        int64_t dataBase;
+        int64_t imageBase;
+        uint32_t sectionSize[2];
+        uint32_t imageSize;
+        uint32_t wordCount; // text words: source lines and decoded records
+    };
+    // Followed by image[imageSize], int32 sourceLines[wordCount],
+    // DecodedInst decoded[wordCount], then per label: int64 address,
+    // uint32 name length, name bytes.
+    static_assert(is_trivially_copyable_v<DecodedInst> && sizeof(DecodedInst) == 8);
+
+    // FNV-1a over the source, salted with everything else that shapes the output
+    static uint64_t programCacheKey(string_view source, sreg base = DEFAULT_TEXT_BASE)
+    {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void *p, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+                h = (h ^ static_cast<const uint8_t *>(p)[i]) * 1099511628211ull;
+        };
+        const int64_t salt[] = {ASSEMBLER_VERSION, XLEN, base};
+        mix(salt, sizeof(salt));
+        mix(source.data(), source.size());
+        return h;
+    }
+
+    // Serializes the program assembled by the last loadProgram(); false when
+    // it should not be cached (errors, or .incbin input the key cannot see)
+    bool saveProgramCache(uint64_t key, vector<uint8_t> &out) const
+    {
+        if (lineSection.empty() || assembleErrors || pendingStatements)
+            return false;
+        for (const auto &inst : program)
+            if (inst.op == ".INCBIN")
+                return false;
+
+        CacheHeader h = {{'R', 'V', 'P', 'C'}, ASSEMBLER_VERSION, XLEN, (uint32_t)labels.size(), key,
+                         textBase, dataBase, imageBase, {sectionSize[0], sectionSize[1]},
+                         (uint32_t)image.size(), (uint32_t)sourceLines.size()};
+        out.clear();
+        auto put = [&out](const void *p, size_t n)
+        {
+            out.insert(out.end(), static_cast<const uint8_t *>(p), static_cast<const uint8_t *>(p) + n);
+        };
+        put(&h, sizeof(h));
+        put(image.data(), image.size());
+        for (int line : sourceLines)
+            put(&line, sizeof(int32_t));
+        for (size_t i = 0; i < sourceLines.size(); ++i)
+        {
+            // words past the image (a trailing partial word) decode as zero
+            size_t off = (size_t)(textBase - imageBase) + 4 * i;
+            uint32_t word = 0;
+            memcpy(&word, image.data() + off, min<size_t>(4, image.size() - off));
+            DecodedInst d = decodeWord<XLEN>(word);
+            put(&d, sizeof(d));
+        }
+        for (const auto &[name, addr] : labels)
+        {
+            int64_t a = addr;
+            uint32_t n = name.size();
+            put(&a, sizeof(a));
+            put(&n, sizeof(n));
+            put(name.data(), n);
+        }
+        return true;
+    }
+
+    // Restores a program saved by saveProgramCache() for `source`, whose
+    // key the caller computed; false if the blob does not match or does not
+    // describe a consistent image, in which case nothing is changed. The
+    // source is kept so updateLines() still works (its first call re-parses
+    // fully).
+    bool loadProgramCache(const uint8_t *data, size_t size, string_view source, uint64_t key)
+    {
+        CacheHeader h;
+        size_t pos = 0;
+        auto take = [&](void *dst, size_t n)
+        {
+            if (size - pos < n)
+                return false;
+            memcpy(dst, data + pos, n);
+            pos += n;
+            return true;
+        };
+        const uint64_t perWord = sizeof(int32_t) + sizeof(DecodedInst);
+        if (!take(&h, sizeof(h)) || memcmp(h.magic, "RVPC", 4) != 0 || h.version != ASSEMBLER_VERSION ||
+            h.xlen != XLEN || h.key != key || size - pos < h.imageSize + h.wordCount * perWord)
+            return false;
+
+        // The sections must fill the image exactly and the text words cover
+        // .text, so resetToImage() and the decode cache copy stay in bounds.
+        // Bases are addresses an sreg holds, far enough from the int64 limit
+        // that adding a section size cannot overflow.
+        auto validBase = [](int64_t a)
+        { return a >= 0 && a == (sreg)a && a < numeric_limits<int64_t>::max() / 2; };
+        const uint32_t textSize = h.sectionSize[SECTION_TEXT], dataSize = h.sectionSize[SECTION_DATA];
+        if (!validBase(h.textBase) || h.textBase % 4 != 0 || !validBase(h.dataBase) ||
+            h.imageBase != (dataSize ? min(h.textBase, h.dataBase) : h.textBase) ||
+            h.wordCount != (textSize + 3ull) / 4)
+            return false;
+        const int64_t textEnd = h.textBase + textSize;
+        const int64_t end = dataSize ? max(textEnd, h.dataBase + dataSize) : textEnd;
+        if ((uint64_t)(end - h.imageBase) != h.imageSize)
+            return false;
+        const uint8_t *imageData = data + pos;
+        const uint8_t *lineData = imageData + h.imageSize;
+        const uint8_t *decoded = lineData + (size_t)h.wordCount * sizeof(int32_t);
+        pos += h.imageSize + h.wordCount * perWord;
+
+        decltype(labels) restored;
+        for (uint32_t i = 0; i < h.labelCount; ++i)
+        {
+            int64_t addr;
+            uint32_t n;
+            if (!take(&addr, sizeof(addr)) || !take(&n, sizeof(n)) || size - pos < n)
+                return false;
+            restored.emplace(string(reinterpret_cast<const char *>(data + pos), n), (sreg)addr);
+            pos += n;
+        }
+
+        labels.swap(restored);
+        textBase = (sreg)h.textBase;
+        dataBase = (sreg)h.dataBase;
+        imageBase = (sreg)h.imageBase;
+        sectionSize[SECTION_TEXT] = h.sectionSize[SECTION_TEXT];
+        sectionSize[SECTION_DATA] = h.sectionSize[SECTION_DATA];
+        image.assign(imageData, imageData + h.imageSize);
+        sourceLines.resize(h.wordCount);
+        for (size_t i = 0; i < sourceLines.size(); ++i)
+        {
+            int32_t line;
+            memcpy(&line, lineData + 4 * i, sizeof(line));
+            sourceLines[i] = line;
+        }
+
+        sourceChunks.clear();
+        sourceText.clear();
+        splitLines(sourceChunks.emplace_back(source), sourceText);
+        program.clear();
+        labelDefs.clear();
+        lineSection.clear(); // not parsed
+        pendingStatements = 0;
+        requestedDataBase = -1;
+        assembleErrors = 0;
+        resetToImage();
+        memcpy(decodeCache.data() + textBase / 4, decoded, (size_t)h.wordCount * sizeof(DecodedInst));
+        logLoaded("Program loaded from cache");
+        return true;
+    }
+
+#ifndef __EMSCRIPTEN__
+    // loadProgram() through an on-disk cache in `dir`: a hit maps the entry
+    // read-only and never runs the assembler; a miss assembles and stores
+    // it. Returns whether the cache was hit.
+    bool loadProgramCached(string source, const string &dir)
+    {
+        uint64_t key = programCacheKey(source);
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.rvpc", (unsigned long long)key);
+        string path = dir + name;
+
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            bool hit = mapped != MAP_FAILED &&
+                       loadProgramCache(static_cast<const uint8_t *>(mapped), (size_t)st.st_size, source, key);
+            if (mapped != MAP_FAILED)
+                munmap(mapped, (size_t)st.st_size);
+            if (hit)
+                return true;
+        }
+        else if (fd >= 0)
+            close(fd);
+
+        loadProgram(move(source));
+        vector<uint8_t> blob;
+        if (saveProgramCache(key, blob))
+        {
+            // write-then-rename so a concurrent reader never sees half an entry
+            mkdir(dir.c_str(), 0755);
+            string tmp = path + "." + to_string(getpid());
+            ofstream(tmp, ios::binary).write(reinterpret_cast<const char *>(blob.data()), blob.size());
+            if (rename(tmp.c_str(), path.c_str()) != 0)
+                unlink(tmp.c_str());
+        }
+        return false;
+    }
+#endif
+
+    //---------------------------------
+    // ELF loading
+    //---------------------------------
+    bool loadElf(const string &path)
+    {
+#ifndef __EMSCRIPTEN__
+        // Native: map the file read-only and copy segments straight from the mapping
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            if (fd >= 0)
+                close(fd);
+            cerr << "[Error] Cannot open ELF file: " << path << "\n";
+            return false;
+        }
+        void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            cerr << "[Error] Cannot map ELF file: " << path << "\n";
+            return false;
+        }
+        bool ok = loadElf(static_cast<const uint8_t *>(mapped), (size_t)st.st_size);
+        munmap(mapped, (size_t)st.st_size);
+        return ok;
+#else
+        ifstream in(path, ios::binary);
+        if (!in)
+        {
+            cerr << "[Error] Cannot open ELF file: " << path << "\n";
+            return false;
+        }
+        vector<uint8_t> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        return loadElf(bytes.data(), bytes.size());
+#endif
+    }
+
+    // Statically linked RISC-V executable of this build's XLEN
+    bool loadElf(const uint8_t *data, size_t size)
+    {
+        using Elf = ElfTypes<XLEN>;
+        typename Elf::Ehdr eh;
+        if (!readElf(data, size, 0, eh) || memcmp(eh.ident, "\x7f" "ELF", 4) != 0)
+        {
+            cerr << "[Error] Not an ELF file.\n";
+            return false;
+        }
+        if (eh.ident[4] != Elf::ELF_CLASS || eh.ident[5] != 1 || eh.machine != ELF_EM_RISCV)
+        {
+            cerr << "[Error] ELF is not a little-endian RV" << XLEN << " image.\n";
+            return false;
+        }
+        if (eh.type != ELF_ET_EXEC)
+        {
+            cerr << "[Error] Only statically linked executables are supported.\n";
+            return false;
+        }
+
+        // Size guest memory to cover every PT_LOAD segment plus the stack
+        vector<typename Elf::Phdr> loads;
+        uint64_t end = 0;
+        for (size_t i = 0; i < eh.phnum; ++i)
+        {
+            typename Elf::Phdr ph;
+            if (!readElf(data, size, eh.phoff + i * eh.phentsize, ph))
+            {
+                cerr << "[Error] Truncated ELF program header.\n";
+                return false;
+            }
+            if (ph.type != ELF_PT_LOAD || ph.memsz == 0)
+                continue;
+            if (ph.filesz > ph.memsz || ph.offset + ph.filesz > size)
+            {
+                cerr << "[Error] Malformed ELF segment " << i << ".\n";
+                return false;
+            }
+            loads.push_back(ph);
+            end = max<uint64_t>(end, (uint64_t)ph.vaddr + ph.memsz);
+        }
+        if (loads.empty())
+        {
+            cerr << "[Error] ELF has no loadable segments.\n";
+            return false;
+        }
+        uint64_t memSize = ((end + 15) & ~(uint64_t)15) + ELF_STACK_SIZE;
+        if (memSize > MAX_GUEST_MEMORY)
+        {
+            cerr << "[Error] ELF segments end at 0x" << hex << end << dec
+                 << ", beyond the " << (MAX_GUEST_MEMORY >> 20) << " MiB guest memory limit.\n";
+            return false;
+        }
+
+        bool keepProfiling = profiling;
+        TimingModel *keepTiming = timing;
+        *this = RiscvCore();
+        profiling = keepProfiling;
+        timing = keepTiming;
+        memory.assign(max<uint64_t>(memSize, memory.size()), 0);
+
+        // Copy file-backed bytes; the rest of memsz (.bss) stays zero
+        for (const auto &ph : loads)
+            memcpy(&memory[ph.vaddr], data + ph.offset, ph.filesz);
+
+        loadElfSymbols(data, size, eh);
+        for (const auto &sym : symbols)
+            if (sym.name == "__global_pointer$")
+                regs.x[3] = (sreg)sym.addr;
+
+        regs.x[2] = (sreg)memory.size();
+        resetDecodeCache();
+        regs.pc = (sreg)eh.entry;
+
+        cerr << "[RISC-V] ELF loaded: " << loads.size() << " segments, entry 0x"
+             << hex << eh.entry << dec << ", " << symbols.size() << " symbols.\n";
+        return true;
+    }
+
+    // Nearest function/object symbol at or below `addr`, or nullptr
+    const Symbol *symbolAt(uint64_t addr) const
+    {
+        auto it = upper_bound(symbols.begin(), symbols.end(), addr,
+                              [](uint64_t a, const Symbol &s)
+                              { return a < s.addr; });
+        if (it == symbols.begin())
+            return nullptr;
+        --it;
+        if (it->size && addr >= it->addr + it->size)
+            return nullptr;
+        return &*it;
+    }
+
+    string getSymbolForPC(int pcValue) const
+    {
+        const Symbol *sym = symbolAt((uint64_t)(ureg)pcValue);
+        return sym ? sym->name : "";
+    }
+
+    // Copy raw RV machine code into guest memory at `base` and run it from there
+    void loadBinary(const uint8_t *data, size_t size, sreg base = 0)
+    {
+        labels.clear();
+        sourceLines.clear();
+        pendingStatements = 0;
+        markAllChanged();
+        instret = 0;
+        eventsDrained = eventsWritten;
+        startTime = chrono::steady_clock::now();
+        reservationAddr = -1;
+
+        if (base < 0)
+            base = 0;
+        if ((size_t)base + size > memory.size())
+            memory.resize(((size_t)base + size + 3) & ~(size_t)3, 0);
+        copy(data, data + size, memory.begin() + base);
+
+        resetDecodeCache();
+        regs.pc = base;
+
+        cerr << "[RISC-V] Binary loaded: " << size << " bytes at 0x" << hex << base << dec << ".\n";
+    }
+
+    //---------------------------------
+    // Step execution
+    //---------------------------------
+    bool step()
+    {
+        // enforce x0 = 0
+        regs.x[0] = 0;
+
+        if (regs.pc < 0 || regs.pc % 4 != 0 || (size_t)regs.pc / 4 >= decodeCache.size())
+        {
+            emitEvent(EventKind::HALT, (uint8_t)HaltCause::PC_RANGE);
+            return false;
+        }
+
+        // Decode on a cache miss only
+        DecodedInst &d = decodeCache[regs.pc / 4];
+        if (d.op == Op::NONE)
+            d = decodeWord<XLEN>(load32(regs.pc));
+
+        ++instret;
+        if (profiling)
+            ++pcCounts[regs.pc / 4];
+        if (traceExec)
+            emitEvent(EventKind::EXEC, 0, bit_cast<uint64_t>(d));
+        if (!timing)
+            return execute(d);
+
+        // execute() may clear the cache slot (store to code), so keep a copy
+        const DecodedInst inst = d;
+        const sreg pc = regs.pc;
+        bool ok = execute(inst);
+        timing->retire(inst, regs.pc != pc + 4);
+        return ok;
+    }
+
+    // Instructions between clock reads in runFor; a clock read costs far
+    // more than an instruction, and a stride this size still finishes well
+    // inside a millisecond
+    static constexpr uint32_t RUN_CLOCK_STRIDE = 4096;
+
+    // Steps until `micros` of wall time or `maxInstructions` (0: no limit)
+    // are spent, or the program halts. The clock is read only every
+    // RUN_CLOCK_STRIDE instructions, so the time budget may overrun by one
+    // stride. Returns false if the program halted.
+    bool runFor(uint32_t micros, uint64_t maxInstructions)
+    {
+        const auto deadline = chrono::steady_clock::now() + chrono::microseconds(micros);
+        uint64_t left = maxInstructions ? maxInstructions : numeric_limits<uint64_t>::max();
+        while (left)
+        {
+            uint64_t n = min<uint64_t>(left, RUN_CLOCK_STRIDE);
+            left -= n;
+            while (n--)
+                if (!step())
+                    return false;
+            if (chrono::steady_clock::now() >= deadline)
+                break;
+        }
+        return true;
+    }
+
+    //---------------------------------
+    // Execution events
+    //---------------------------------
+    // Moves the events recorded since the last call into a linear array
+    // (getEventsPtr(), valid until the next call) and returns their count.
+    // If the ring overflowed, a LOST record comes first.
+    size_t drainEvents()
+    {
+        drainedEvents.clear();
+        if (eventsWritten - eventsDrained > EVENT_RING_SIZE)
+        {
+            Event lost{EventKind::LOST, 0, (uint16_t)Op::NONE, -1, 0, eventsWritten - eventsDrained - EVENT_RING_SIZE, 0};
+            drainedEvents.push_back(lost);
+            eventsDrained = eventsWritten - EVENT_RING_SIZE;
+        }
+        size_t first = eventsDrained % EVENT_RING_SIZE;
+        size_t count = eventsWritten - eventsDrained;
+        size_t tail = min(count, EVENT_RING_SIZE - first);
+        drainedEvents.insert(drainedEvents.end(), eventRing.begin() + first, eventRing.begin() + first + tail);
+        drainedEvents.insert(drainedEvents.end(), eventRing.begin(), eventRing.begin() + (count - tail));
+        eventsDrained = eventsWritten;
+        return drainedEvents.size();
+    }
+    const Event *getEventsPtr() const { return drainedEvents.data(); }
+
+    //---------------------------------
+    // Dump state for GUI
+    //---------------------------------
+    string dumpState() const
+    {
+        stringstream ss;
+        ss << "PC=0x" << hex << regs.pc << dec << "\n";
+        for (int i = 0; i < 32; i++)
+        {
+            ss << "x" << setfill('0') << setw(2) << i << setfill(' ')
+               << "=" << setw(XLEN == 64 ? 20 : 11) << regs.x[i]
+               << ((i + 1) % 8 == 0 ? "\n" : "  ");
+        }
+
+        // Show first 64 words (256 bytes), reconstructed little-endian
+        ss << "\nMemory[words 0..63]: ";
+        int maxWords = min(64, (int)memory.size() / 4);
+        for (int w = 0; w < maxWords; ++w)
+        {
+            int addr = w * 4;
+            uint32_t val = (uint32_t)(memory[addr] |
+                                      (memory[addr + 1] << 8) |
+                                      (memory[addr + 2] << 16) |
+                                      (memory[addr + 3] << 24));
+            ss << dec << val << "(" << hex << showbase << val << noshowbase << dec << ") ";
+        }
+        ss << "\n";
+        return ss.str();
+    }
+
+    //---------------------------------
+    // Performance counters
+    //---------------------------------
+    // Cycles of the attached timing model up to the previous instruction;
+    // without one, every instruction takes one cycle.
+    uint64_t getCycle() const { return timing ? timing->cycleCount() : getInstret(); }
+    // Reads during a step exclude the instruction being executed.
+    uint64_t getInstret() const { return instret ? instret - 1 : 0; }
+    // 1 MHz timebase: microseconds since the program was loaded.
+    uint64_t getTime() const
+    {
+        auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime);
+        return (uint64_t)us.count();
+    }
+
+    //---------------------------------
+    // Profiling
+    //---------------------------------
+    // Turning profiling on or off clears the counts; loading a program
+    // clears them too but keeps the mode
+    void setProfiling(bool on)
+    {
+        profiling = on;
+        pcCounts.assign(on ? decodeCache.size() : 0, 0);
+        takenCounts.assign(pcCounts.size(), 0);
+    }
+
+    // Executions per source line (0-based), up to the last line with code
+    vector<uint64_t> profileByLine() const
+    {
+        vector<uint64_t> counts;
+        size_t first = (size_t)textBase / 4;
+        for (size_t i = 0; i < sourceLines.size() && first + i < pcCounts.size(); ++i)
+        {
+            int line = sourceLines[i];
+            if (line < 0)
+                continue;
+            if ((size_t)line >= counts.size())
+                counts.resize(line + 1, 0);
+            counts[line] += pcCounts[first + i];
+        }
+        return counts;
+    }
+
+    struct FunctionProfile
+    {
+        string name;
+        uint64_t start;
+        uint64_t count;
+    };
+
+    // Executions per function, hottest first. A function runs from its
+    // start to the next one: ELF function symbols when the program has
+    // them, otherwise the labels in .text. Code before the first start is
+    // reported as "(unlabeled)".
+    vector<FunctionProfile> profileByFunction() const
+    {
+        vector<FunctionProfile> funcs;
+        for (const Symbol &sym : symbols)
+            if (sym.isFunc)
+                funcs.push_back({sym.name, sym.addr, 0});
+        if (funcs.empty())
+        {
+            uint64_t textEnd = (uint64_t)textBase + sectionSize[SECTION_TEXT];
+            for (const auto &[name, addr] : labels)
+                if ((uint64_t)addr >= (uint64_t)textBase && (uint64_t)addr < textEnd)
+                    funcs.push_back({name, (uint64_t)addr, 0});
+        }
+        // By address; of labels sharing an address the first by name wins
+        sort(funcs.begin(), funcs.end(), [](const FunctionProfile &a, const FunctionProfile &b)
+             { return a.start != b.start ? a.start < b.start : a.name < b.name; });
+        funcs.erase(unique(funcs.begin(), funcs.end(), [](const FunctionProfile &a, const FunctionProfile &b)
+                           { return a.start == b.start; }),
+                    funcs.end());
+
+        FunctionProfile unlabeled = {"(unlabeled)", 0, 0};
+        for (size_t w = 0; w < pcCounts.size(); ++w)
+        {
+            if (!pcCounts[w])
+                continue;
+            auto it = upper_bound(funcs.begin(), funcs.end(), (uint64_t)w * 4,
+                                  [](uint64_t addr, const FunctionProfile &f)
+                                  { return addr < f.start; });
+            (it == funcs.begin() ? unlabeled : *prev(it)).count += pcCounts[w];
+        }
+        if (unlabeled.count)
+            funcs.push_back(move(unlabeled));
+
+        funcs.erase(remove_if(funcs.begin(), funcs.end(), [](const FunctionProfile &f)
+                              { return f.count == 0; }),
+                    funcs.end());
+        stable_sort(funcs.begin(), funcs.end(), [](const FunctionProfile &a, const FunctionProfile &b)
+                    { return a.count > b.count; });
+        return funcs;
+    }
+
+    struct InstructionMix
+    {
+        uint64_t byClass[(size_t)InstClass::COUNT] = {};
+        uint64_t byOp[(size_t)Op::COUNT] = {};
+    };
+
+    // Executions per op and per class, built from the profile counts when
+    // asked for so that step() pays nothing beyond the counters themselves
+    InstructionMix instructionMix() const
+    {
+        InstructionMix mix;
+        for (size_t w = 0; w < pcCounts.size(); ++w)
+        {
+            uint64_t n = pcCounts[w];
+            if (!n)
+                continue;
+            // A store since the word last ran leaves its cache slot empty
+            Op op = decodeCache[w].op;
+            if (op == Op::NONE)
+            {
+                const uint8_t *p = &memory[w * 4];
+                op = decodeWord<XLEN>((uint32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24))).op;
+            }
+            mix.byOp[(size_t)op] += n;
+            InstClass cls = instClass(op);
+            if (cls == InstClass::BRANCH_TAKEN)
+            {
+                mix.byClass[(size_t)InstClass::BRANCH_TAKEN] += takenCounts[w];
+                mix.byClass[(size_t)InstClass::BRANCH_NOT_TAKEN] += n - takenCounts[w];
+            }
+            else
+                mix.byClass[(size_t)cls] += n;
+        }
+        return mix;
+    }
+
+    //---------------------------------
+    // Read memory (for search)
+    //---------------------------------
+    uint8_t *getMemoryData() { return memory.data(); }
+    size_t getMemorySize() const { return memory.size(); }
+
+    // Register file: x0..x31 then pc, XLEN / 8 bytes each
+    sreg *getRegsPtr() { return regs.x; }
+
+    //---------------------------------
+    // State deltas
+    //---------------------------------
+    // Changes since the previous call as uint32s: flags, the changed-register
+    // mask (bit i = xi; pc is not tracked, it moves every step), the range
+    // count, then per range its first word index (address / 4) and its word
+    // count. DELTA_FULL means the state was replaced or too much changed to
+    // list: re-read everything.
+    static constexpr uint32_t DELTA_FULL = 1;
+    static constexpr uint32_t MAX_DELTA_RANGES = 1024;
+
+    const vector<uint32_t> &consumeDelta()
+    {
+        deltaRecord.assign({deltaFull ? DELTA_FULL : 0, dirtyRegs, 0});
+        sort(dirtyChunks.begin(), dirtyChunks.end());
+        uint32_t ranges = 0;
+        for (uint32_t chunk : dirtyChunks)
+        {
+            uint64_t bits = exchange(dirtyWords[chunk], 0);
+            while (bits)
+            {
+                int lo = countr_zero(bits);
+                int len = countr_one(bits >> lo);
+                uint32_t first = chunk * 64 + lo;
+                if (ranges && deltaRecord[deltaRecord.size() - 2] + deltaRecord.back() == first)
+                    deltaRecord.back() += len; // continues the previous chunk's run
+                else
+                {
+                    deltaRecord.push_back(first);
+                    deltaRecord.push_back(len);
+                    ++ranges;
+                }
+                bits = len == 64 ? 0 : bits & ~(((1ull << len) - 1) << lo);
+            }
+        }
+        if (ranges > MAX_DELTA_RANGES)
+        {
+            deltaRecord.resize(3);
+            deltaRecord[0] |= DELTA_FULL;
+            ranges = 0;
+        }
+        deltaRecord[2] = ranges;
+        dirtyChunks.clear();
+        dirtyRegs = 0;
+        deltaFull = false;
+        return deltaRecord;
+    }
+
+    // For Line Highlights
+    int getSourceLineForPC(int pcValue) const
+    {
+        sreg off = (sreg)pcValue - textBase;
+        if (off < 0 || off / 4 >= (sreg)sourceLines.size())
+            return -1;
+        return sourceLines[off / 4];
+    }
+
+private:
+    //---------------------------------
+    // Helpers
+    //---------------------------------
+    // Records an event for the instruction at pc
+    void emitEvent(EventKind kind, uint8_t detail = 0, uint64_t a = 0, uint64_t b = 0)
+    {
+        bool fetched = regs.pc >= 0 && (size_t)regs.pc / 4 < decodeCache.size();
+        Op op = fetched ? decodeCache[regs.pc / 4].op : Op::NONE;
+        eventRing[eventsWritten++ % EVENT_RING_SIZE] = {kind, detail, (uint16_t)op, getSourceLineForPC(regs.pc), regs.pc, a, b};
+    }
+
+    void writeReg(int rd, sreg val)
+    {
+        if (rd != 0)
+        {
+            dirtyRegs |= (uint32_t)(regs.x[rd] != val) << rd;
+            regs.x[rd] = val;
+        }
+    }
+
+    //---------------------------------
+    // Execution of decoded instructions
+    //---------------------------------
+    bool execute(const DecodedInst &d)
+    {
+        const sreg a = regs.x[d.rs1], b = regs.x[d.rs2];
+        const sreg imm = d.imm;
+        sreg next = regs.pc + 4;
+
+        switch (d.op)
+        {
+        // -------- Upper immediate / jumps --------
+        case Op::LUI:
+            writeReg(d.rd, imm);
+            break;
+        case Op::AUIPC:
+            writeReg(d.rd, regs.pc + imm);
+            break;
+        case Op::JAL:
+            writeReg(d.rd, next);
+            next = regs.pc + imm;
+            break;
+        case Op::JALR:
+            next = (a + imm) & ~(sreg)1;
+            writeReg(d.rd, regs.pc + 4);
+            break;
+
+        // -------- Branches --------
+        case Op::BEQ:
+        case Op::BNE:
+        case Op::BLT:
+        case Op::BGE:
+        case Op::BLTU:
+        case Op::BGEU:
+        {
+            bool take = false;
+            if (d.op == Op::BEQ)
+                take = a == b;
+            else if (d.op == Op::BNE)
+                take = a != b;
+            else if (d.op == Op::BLT)
+                take = a < b;
+            else if (d.op == Op::BGE)
+                take = a >= b;
+            else if (d.op == Op::BLTU)
+                take = (ureg)a < (ureg)b;
+            else
+                take = (ureg)a >= (ureg)b;
+
+            if (take)
+            {
+                next = regs.pc + imm;
+                if (profiling)
+                    ++takenCounts[regs.pc / 4];
+            }
+            if (traceExec)
+                emitEvent(EventKind::BRANCH, take, (uint64_t)(int64_t)next);
+            break;
+        }
+
+        // -------- Loads / stores --------
+        case Op::LB:
+            if (!validAddrByte(a + imm))
+                return false;
+            writeReg(d.rd, sext8(load8(a + imm)));
+            break;
+        case Op::LBU:
+            if (!validAddrByte(a + imm))
+                return false;
+            writeReg(d.rd, zext8(load8(a + imm)));
+            break;
+        case Op::LH:
+            if (!checkAccess(a + imm, 2))
+                return false;
+            writeReg(d.rd, sext16(load16(a + imm)));
+            break;
+        case Op::LHU:
+            if (!checkAccess(a + imm, 2))
+                return false;
+            writeReg(d.rd, zext16(load16(a + imm)));
+            break;
+        case Op::LW:
+            if (!checkAccess(a + imm, 4))
+                return false;
+            writeReg(d.rd, sext32(load32(a + imm)));
+            break;
+        case Op::LWU:
+            if (!checkAccess(a + imm, 4))
+                return false;
+            writeReg(d.rd, (sreg)load32(a + imm));
+            break;
+        case Op::LD:
+            if (!checkAccess(a + imm, 8))
+                return false;
+            writeReg(d.rd, (sreg)load64(a + imm));
+            break;
+        case Op::SB:
+            if (!validAddrByte(a + imm))
+                return false;
+            store8(a + imm, (uint8_t)b);
+            break;
+        case Op::SH:
+            if (!checkAccess(a + imm, 2))
+                return false;
+            store16(a + imm, (uint16_t)b);
+            break;
+        case Op::SW:
+            if (!checkAccess(a + imm, 4))
+                return false;
+            store32(a + imm, (uint32_t)b);
+            break;
+        case Op::SD:
+            if (!checkAccess(a + imm, 8))
+                return false;
+            store64(a + imm, (uint64_t)b);
+            break;
+
+        // -------- Arithmetic / Logic --------
+        case Op::ADDI:
+            writeReg(d.rd, (sreg)((ureg)a + (ureg)imm));
+            break;
+        case Op::SLTI:
+            writeReg(d.rd, a < imm);
+            break;
+        case Op::SLTIU:
+            writeReg(d.rd, (ureg)a < (ureg)imm);
+            break;
+        case Op::XORI:
+            writeReg(d.rd, a ^ imm);
+            break;
+        case Op::ORI:
+            writeReg(d.rd, a | imm);
+            break;
+        case Op::ANDI:
+            writeReg(d.rd, a & imm);
+            break;
+        case Op::SLLI:
+            writeReg(d.rd, (sreg)((ureg)a << imm));
+            break;
+        case Op::SRLI:
+            writeReg(d.rd, (sreg)((ureg)a >> imm));
+            break;
+        case Op::SRAI:
+            writeReg(d.rd, a >> imm);
+            break;
+        case Op::ADD:
+            writeReg(d.rd, (sreg)((ureg)a + (ureg)b));
+            break;
+        case Op::SUB:
+            writeReg(d.rd, (sreg)((ureg)a - (ureg)b));
+            break;
+        case Op::SLL:
+            writeReg(d.rd, (sreg)((ureg)a << (b & (XLEN - 1))));
+            break;
+        case Op::SLT:
+            writeReg(d.rd, a < b);
+            break;
+        case Op::SLTU:
+            writeReg(d.rd, (ureg)a < (ureg)b);
+            break;
+        case Op::XOR:
+            writeReg(d.rd, a ^ b);
+            break;
+        case Op::SRL:
+            writeReg(d.rd, (sreg)((ureg)a >> (b & (XLEN - 1))));
+            break;
+        case Op::SRA:
+            writeReg(d.rd, a >> (b & (XLEN - 1)));
+            break;
+        case Op::OR:
+            writeReg(d.rd, a | b);
+            break;
+        case Op::AND:
+            writeReg(d.rd, a & b);
+            break;
+
+        // -------- M extension --------
+        case Op::MUL:
+            writeReg(d.rd, (sreg)((ureg)a * (ureg)b));
+            break;
+        case Op::MULH:
+            writeReg(d.rd, mulHigh(a, b, true, true));
+            break;
+        case Op::MULHSU:
+            writeReg(d.rd, mulHigh(a, b, true, false));
+            break;
+        case Op::MULHU:
+            writeReg(d.rd, mulHigh(a, b, false, false));
+            break;
+        case Op::DIV:
+            writeReg(d.rd, divSigned(a, b));
+            break;
+        case Op::DIVU:
+            writeReg(d.rd, b ? (sreg)((ureg)a / (ureg)b) : (sreg)-1);
+            break;
+        case Op::REM:
+            writeReg(d.rd, remSigned(a, b));
+            break;
+        case Op::REMU:
+            writeReg(d.rd, b ? (sreg)((ureg)a % (ureg)b) : a);
+            break;
+
+        // -------- RV64I word ops --------
+        case Op::ADDIW:
+            writeReg(d.rd, sext32((uint32_t)a + (uint32_t)imm));
+            break;
+        case Op::SLLIW:
+            writeReg(d.rd, sext32((uint32_t)a << imm));
+            break;
+        case Op::SRLIW:
+            writeReg(d.rd, sext32((uint32_t)a >> imm));
+            break;
+        case Op::SRAIW:
+            writeReg(d.rd, (int32_t)a >> imm);
+            break;
+        case Op::ADDW:
+            writeReg(d.rd, sext32((uint32_t)a + (uint32_t)b));
+            break;
+        case Op::SUBW:
+            writeReg(d.rd, sext32((uint32_t)a - (uint32_t)b));
+            break;
+        case Op::SLLW:
+            writeReg(d.rd, sext32((uint32_t)a << (b & 0x1F)));
+            break;
+        case Op::SRLW:
+            writeReg(d.rd, sext32((uint32_t)a >> (b & 0x1F)));
+            break;
+        case Op::SRAW:
+            writeReg(d.rd, (int32_t)a >> (b & 0x1F));
+            break;
+        case Op::MULW:
+            writeReg(d.rd, sext32((uint32_t)a * (uint32_t)b));
+            break;
+        case Op::DIVW:
+            writeReg(d.rd, divSigned((int32_t)a, (int32_t)b));
+            break;
+        case Op::DIVUW:
+            writeReg(d.rd, (uint32_t)b ? sext32((uint32_t)a / (uint32_t)b) : (sreg)-1);
+            break;
+        case Op::REMW:
+            writeReg(d.rd, remSigned((int32_t)a, (int32_t)b));
+            break;
+        case Op::REMUW:
+            writeReg(d.rd, (uint32_t)b ? sext32((uint32_t)a % (uint32_t)b) : sext32((uint32_t)a));
+            break;
+
+        // -------- System --------
+        case Op::FENCE:
+            break;
+        case Op::ECALL:
+            emitEvent(EventKind::HALT, (uint8_t)HaltCause::ECALL);
+            return false;
+        case Op::EBREAK:
+            emitEvent(EventKind::HALT, (uint8_t)HaltCause::EBREAK);
+            return false;
+        case Op::CSRRW:
+        case Op::CSRRS:
+        case Op::CSRRC:
+        case Op::CSRRWI:
+        case Op::CSRRSI:
+        case Op::CSRRCI:
+            // CSRRW[I] always writes; the set/clear forms only with rs1/uimm != 0
+            if (!csrAccess(d.rd, d.imm, d.op == Op::CSRRW || d.op == Op::CSRRWI || d.rs1 != 0))
+                return false;
+            break;
+
+        default:
+            if (opInfo(d.op).fmt == Fmt::AMO)
+            {
+                if (!atomicOp(d.op, d.rd, d.rs2, a))
+                    return false;
+                break;
+            }
+            emitEvent(EventKind::FAULT, (uint8_t)FaultKind::ILLEGAL, load32(regs.pc));
+            return false;
+        }
+
+        regs.x[0] = 0;
+        regs.pc = next;
+        return true;
+    }
+
+    bool checkAccess(sreg addr, int size)
+    {
+        return checkAligned(addr, size) && validAddrByte(addr) && validAddrByte(addr + size - 1);
+    }
+
+    // Upper XLEN bits of the 2*XLEN-bit product
+    static sreg mulHigh(sreg a, sreg b, bool aSigned, bool bSigned)
+    {
+        if constexpr (XLEN == 32)
+        {
+            int64_t x = aSigned ? (int64_t)a : (int64_t)(uint32_t)a;
+            int64_t y = bSigned ? (int64_t)b : (int64_t)(uint32_t)b;
+            return (sreg)((uint64_t)(x * y) >> 32);
+        }
+        else
+        {
+            __int128 x = aSigned ? (__int128)a : (__int128)(uint64_t)a;
+            __int128 y = bSigned ? (__int128)b : (__int128)(uint64_t)b;
+            return (sreg)((unsigned __int128)(x * y) >> 64);
+        }
+    }
+
+    // Division by zero and overflow follow the spec instead of trapping
+    template <typename S>
+    static sreg divSigned(S a, S b)
+    {
+        if (b == 0)
+            return -1;
+        if (b == -1 && a == numeric_limits<S>::min())
+            return a;
+        return a / b;
+    }
+    template <typename S>
+    static sreg remSigned(S a, S b)
+    {
+        if (b == 0)
+            return a;
+        if (b == -1 && a == numeric_limits<S>::min())
+            return 0;
+        return a % b;
+    }
+
+    //---------------------------------
+    // A extension (LR/SC, AMOs)
+    //---------------------------------
+    // Host atomics are seq_cst, which covers any .aq/.rl ordering
+    bool atomicOp(Op op, int rd, int rs2, sreg addr)
+    {
+        // the .D ops follow every .W op in the table
+        return op >= Op::LR_D ? amo<uint64_t>(op, rd, rs2, addr) : amo<uint32_t>(op, rd, rs2, addr);
+    }
+
+    template <typename T>
+    bool amo(Op op, int rd, int rs2, sreg addr)
+    {
+        using S = make_signed_t<T>;
+
+        if (!checkAligned(addr, sizeof(T)) || !validAddrByte(addr + sizeof(T) - 1))
+            return false;
+
+        if (op == Op::LR_W || op == Op::LR_D)
+        {
+            // LR only reads, but lazily assembled code under it must exist
+            if (pendingStatements)
+                for (size_t i = 0; i < sizeof(T); i += 4)
+                    assembleAt(addr + i);
+        }
+        else
+            for (size_t i = 0; i < sizeof(T); i += 4)
+                beforeWrite(addr + i);
+        atomic_ref<T> cell(*reinterpret_cast<T *>(&memory[addr]));
+        T src = (T)regs.x[rs2];
+        T old;
+
+        switch (op)
+        {
+        case Op::LR_W:
+        case Op::LR_D:
+            old = cell.load();
+            reservationAddr = addr;
+            reservationValue = old;
+            break;
+        case Op::SC_W:
+        case Op::SC_D:
+        {
+            // Succeeds only if the reserved word still holds the value LR saw
+            T expected = (T)reservationValue;
+            bool ok = reservationAddr == addr && cell.compare_exchange_strong(expected, src);
+            reservationAddr = -1;
+            writeReg(rd, ok ? 0 : 1);
+            return true;
+        }
+        case Op::AMOSWAP_W:
+        case Op::AMOSWAP_D:
+            old = cell.exchange(src);
+            break;
+        case Op::AMOADD_W:
+        case Op::AMOADD_D:
+            old = cell.fetch_add(src);
+            break;
+        case Op::AMOAND_W:
+        case Op::AMOAND_D:
+            old = cell.fetch_and(src);
+            break;
+        case Op::AMOOR_W:
+        case Op::AMOOR_D:
+            old = cell.fetch_or(src);
+            break;
+        case Op::AMOXOR_W:
+        case Op::AMOXOR_D:
+            old = cell.fetch_xor(src);
+            break;
+        case Op::AMOMIN_W:
+        case Op::AMOMIN_D:
+            old = atomicUpdate(cell, [](T a, T b)
+                               { return (S)a < (S)b ? a : b; }, src);
+            break;
+        case Op::AMOMAX_W:
+        case Op::AMOMAX_D:
+            old = atomicUpdate(cell, [](T a, T b)
+                               { return (S)a > (S)b ? a : b; }, src);
+            break;
+        case Op::AMOMINU_W:
+        case Op::AMOMINU_D:
+            old = atomicUpdate(cell, [](T a, T b)
+                               { return a < b ? a : b; }, src);
+            break;
+        case Op::AMOMAXU_W:
+        case Op::AMOMAXU_D:
+            old = atomicUpdate(cell, [](T a, T b)
+                               { return a > b ? a : b; }, src);
+            break;
+        default:
+            emitEvent(EventKind::FAULT, (uint8_t)FaultKind::ILLEGAL, load32(regs.pc));
+            return false;
+        }
+
+        // .W results are sign-extended to XLEN
+        writeReg(rd, (sreg)(S)old);
+        return true;
+    }
+
+    // CAS loop for the AMOs with no single host instruction
+    template <typename T, typename F>
+    static T atomicUpdate(atomic_ref<T> cell, F fn, T src)
+    {
+        T old = cell.load();
+        while (!cell.compare_exchange_weak(old, fn(old, src)))
+        {
+        }
+        return old;
+    }
+
+    pair<int, int> parseMem(string_view s) const
+    {
+        size_t lparen = s.find('(');
+        size_t rparen = s.find(')');
+        if (lparen == string_view::npos || rparen == string_view::npos || rparen < lparen)
+            throw runtime_error("Invalid memory syntax: " + string(s));
+
+        int imm = parseNumber(s.substr(0, lparen));
+        int rs = regNum(s.substr(lparen + 1, rparen - lparen - 1));
+        return {imm, rs};
+    }
+
+    static int regNum(string_view s)
+    {
+        string_view name = trim(s);
+        int n = REG_NAME_TABLE.find(name);
+        if (n >= 0)
+            return n;
+
+        // Other spellings of xN ("x05", "X0x1f")
+        if (!name.empty() && (name[0] == 'x' || name[0] == 'X'))
+        {
+            n = parseNumber(name.substr(1));
+            if (n < 0 || n > 31)
+            {
+                cerr << "[Error] Invalid register: " << s << "\n";
+                return 0;
+            }
+            return n;
+        }
+
+        cerr << "[Warning] Unknown register name: " << s << " → default x0\n";
+        return 0;
+    }
+
+    static int csrNum(string_view s)
+    {
+        int csr = CSR_NAME_TABLE.find(s);
+        return csr >= 0 ? csr : parseNumber(s) & 0xFFF;
+    }
+
+    // Zicsr: every supported CSR is a read-only counter
+    bool csrAccess(int rd, int csr, bool writes)
+    {
+        ureg value;
+        if (!readCsr(csr, value))
+        {
+            emitEvent(EventKind::FAULT, (uint8_t)FaultKind::CSR, csr);
+            return false;
+        }
+        if (writes)
+        {
+            emitEvent(EventKind::FAULT, (uint8_t)FaultKind::CSR_READONLY, csr);
+            return false;
+        }
+        writeReg(rd, (sreg)value);
+        return true;
+    }
+
+    bool readCsr(int csr, ureg &value) const
+    {
+        switch (csr)
+        {
+        case CSR_CYCLE:
+            value = (ureg)getCycle();
+            return true;
+        case CSR_TIME:
+            value = (ureg)getTime();
+            return true;
+        case CSR_INSTRET:
+            value = (ureg)getInstret();
+            return true;
+        // The high halves only exist on RV32
+        case CSR_CYCLEH:
+            value = (ureg)(getCycle() >> 32);
+            return XLEN == 32;
+        case CSR_TIMEH:
+            value = (ureg)(getTime() >> 32);
+            return XLEN == 32;
+        case CSR_INSTRETH:
+            value = (ureg)(getInstret() >> 32);
+            return XLEN == 32;
+        default:
+            return false;
+        }
+    }
+
+    static string_view trim(string_view s)
+    {
+        size_t a = s.find_first_not_of(" \t\r"), b = s.find_last_not_of(" \t\r");
+        return a == string_view::npos ? string_view() : s.substr(a, b - a + 1);
+    }
+
+    // Decimal or 0x-hex with an optional sign, as a 64-bit value; unsigned
+    // constants above INT64_MAX wrap like the two's-complement bit pattern
+    static int64_t parseValue(string_view numStr)
+    {
+        string_view s = trim(numStr);
+        if (s.empty())
+            return 0;
+
+        bool negative = s[0] == '-';
+        if (negative || s[0] == '+')
+            s.remove_prefix(1);
+        int radix = 10;
+        if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+        {
+            radix = 16;
+            s.remove_prefix(2);
+        }
+
+        uint64_t v = 0;
+        auto [end, ec] = from_chars(s.data(), s.data() + s.size(), v, radix);
+        if (s.empty() || ec != errc() || end != s.data() + s.size())
+            throw runtime_error("Bad immediate: " + string(trim(numStr)));
+        if (negative && v > (uint64_t)1 << 63)
+            throw runtime_error("Constant out of 64-bit range: " + string(trim(numStr)));
+        return (int64_t)(negative ? 0 - v : v);
+    }
+
+    // A 32-bit constant: signed, or unsigned up to 0xFFFFFFFF, which wraps
+    // like RV32 (0xFFFFFFFF is -1). Anything wider is an error.
+    static int parseNumber(string_view numStr)
+    {
+        int64_t v = parseValue(numStr);
+        if (v < INT32_MIN || v > (int64_t)UINT32_MAX)
+            throw runtime_error("Constant out of 32-bit range: " + string(trim(numStr)));
+        return (int)(uint32_t)v;
+    }
+
+    // ---- Address checks ----
+    bool validAddrByte(sreg addr)
+    {
+        if (addr < 0 || addr >= (sreg)memory.size())
+        {
+            emitEvent(EventKind::FAULT, (uint8_t)FaultKind::BOUNDS, (ureg)addr, memory.size() - 1);
+            return false;
+        }
+        return true;
+    }
+    bool checkAligned(sreg addr, int align)
+    {
+        if (addr % align != 0)
+        {
+            emitEvent(EventKind::MISALIGNED, align, (ureg)addr);
+            return false;
+        }
+        return true;
+    }
+
+    // ---- Little-endian loads ----
+    uint8_t load8(sreg addr)
+    {
+        if (!validAddrByte(addr))
+            return 0;
+        if (pendingStatements)
+            assembleAt(addr);
+        return memory[addr];
+    }
+    uint16_t load16(sreg addr)
+    {
+        if (!validAddrByte(addr) || !validAddrByte(addr + 1))
+            return 0;
+        if (pendingStatements)
+            assembleAt(addr);
+        // little-endian
+        return (uint16_t)(memory[addr] | (memory[addr + 1] << 8));
+    }
+    uint32_t load32(sreg addr)
+    {
+        if (!validAddrByte(addr) || !validAddrByte(addr + 3))
+            return 0;
+        if (pendingStatements)
+            assembleAt(addr);
+        return (uint32_t)(memory[addr] | (memory[addr + 1] << 8) | (memory[addr + 2] << 16) | (memory[addr + 3] << 24));
+    }
+    uint64_t load64(sreg addr)
+    {
+        return (uint64_t)load32(addr) | ((uint64_t)load32(addr + 4) << 32);
+    }
+
+    // ---- Little-endian stores ----
+    void store8(sreg addr, uint8_t v)
+    {
+        if (!validAddrByte(addr))
+            return;
+        beforeWrite(addr);
+        memory[addr] = v;
+    }
+    void store16(sreg addr, uint16_t v)
+    {
+        if (!validAddrByte(addr) || !validAddrByte(addr + 1))
+            return;
+        beforeWrite(addr);
+        memory[addr] = (uint8_t)(v & 0xFF);
+        memory[addr + 1] = (uint8_t)((v >> 8) & 0xFF);
+    }
+    void store32(sreg addr, uint32_t v)
+    {
+        if (!validAddrByte(addr) || !validAddrByte(addr + 3))
+            return;
+        beforeWrite(addr);
+        memory[addr] = (uint8_t)(v & 0xFF);
+        memory[addr + 1] = (uint8_t)((v >> 8) & 0xFF);
+        memory[addr + 2] = (uint8_t)((v >> 16) & 0xFF);
+        memory[addr + 3] = (uint8_t)((v >> 24) & 0xFF);
+    }
+    void store64(sreg addr, uint64_t v)
+    {
+        store32(addr, (uint32_t)v);
+        store32(addr + 4, (uint32_t)(v >> 32));
+    }
+
+    //---------------------------------
+    // ELF helpers
+    //---------------------------------
+    template <typename T>
+    static bool readElf(const uint8_t *data, size_t size, uint64_t offset, T &out)
+    {
+        if (offset > size || size - offset < sizeof(T))
+            return false;
+        memcpy(&out, data + offset, sizeof(T));
+        return true;
+    }
+
+    void loadElfSymbols(const uint8_t *data, size_t size, const typename ElfTypes<XLEN>::Ehdr &eh)
+    {
+        using Elf = ElfTypes<XLEN>;
+        symbols.clear();
+        for (size_t i = 0; i < eh.shnum; ++i)
+        {
+            typename Elf::Shdr sh, strtab;
+            if (!readElf(data, size, eh.shoff + i * eh.shentsize, sh) || sh.type != ELF_SHT_SYMTAB)
+                continue;
+            if (!readElf(data, size, eh.shoff + (uint64_t)sh.link * eh.shentsize, strtab) ||
+                strtab.offset + strtab.size > size)
+                continue;
+
+            const char *names = reinterpret_cast<const char *>(data + strtab.offset);
+            for (uint64_t off = 0; off + sizeof(typename Elf::Sym) <= sh.size; off += sizeof(typename Elf::Sym))
+            {
+                typename Elf::Sym sym;
+                if (!readElf(data, size, sh.offset + off, sym))
+                    break;
+                if (sym.name == 0 || sym.name >= strtab.size || sym.shndx == 0)
+                    continue;
+                Symbol s;
+                s.name.assign(names + sym.name, strnlen(names + sym.name, strtab.size - sym.name));
+                s.addr = sym.value;
+                s.size = sym.size;
+                s.isFunc = (sym.info & 0xF) == ELF_STT_FUNC;
+                symbols.push_back(move(s));
+            }
+        }
+        sort(symbols.begin(), symbols.end(), [](const Symbol &a, const Symbol &b)
+             { return a.addr < b.addr; });
+    }
+
+    // Every guest write lands here first: a pending lazy statement is
+    // assembled so the write goes on top of it, the word's cached decode is
+    // dropped (self-modifying code) and the word is marked for consumeDelta()
+    void beforeWrite(sreg addr)
+    {
+        if (pendingStatements)
+            assembleAt(addr);
+        size_t slot = (size_t)addr >> 2;
+        if (slot < decodeCache.size())
+            decodeCache[slot].op = Op::NONE;
+
+        size_t chunk = slot >> 6;
+        if (chunk >= dirtyWords.size())
+            dirtyWords.resize(chunk + 1, 0);
+        if (!dirtyWords[chunk])
+            dirtyChunks.push_back((uint32_t)chunk);
+        dirtyWords[chunk] |= 1ull << (slot & 63);
+    }
+
+    // Registers and memory were replaced wholesale (load, reset)
+    // Empty decode cache (and profile counts, timing state) covering all of memory
+    void resetDecodeCache()
+    {
+        decodeCache.assign(memory.size() / 4, DecodedInst{});
+        pcCounts.assign(profiling ? decodeCache.size() : 0, 0);
+        takenCounts.assign(pcCounts.size(), 0);
+        if (timing)
+            timing->reset();
+    }
+
+    void markAllChanged()
+    {
+        deltaFull = true;
+        dirtyRegs = 0;
+        dirtyWords.clear();
+        dirtyChunks.clear();
+    }
+
+    // ---- Sign/zero extension helpers ----
+    static int sext8(uint8_t v) { return (int)(int8_t)v; }
+    static int sext16(uint16_t v) { return (int)(int16_t)v; }
+    static int zext8(uint8_t v) { return (int)v; }
+    static int zext16(uint16_t v) { return (int)v; }
+    static sreg sext32(uint32_t v) { return (sreg)(int32_t)v; }
+
+    //---------------------------------
+    // Assembler helpers
+    //---------------------------------
+    // Replaces v[from, to) with `with`, moving the tail at most once
+    template <typename T>
+    static void splice(vector<T> &v, size_t from, size_t to, const vector<T> &with)
+    {
+        size_t common = min(to - from, with.size());
+        copy_n(with.begin(), common, v.begin() + from);
+        if (common < with.size())
+            v.insert(v.begin() + to, with.begin() + common, with.end());
+        else
+            v.erase(v.begin() + from + common, v.begin() + to);
+    }
+
+    // Appends a view of each '\n'-terminated line (the last may lack one)
+    static void splitLines(string_view text, vector<string_view> &out)
+    {
+        for (size_t start = 0; start < text.size();)
+        {
+            size_t end = min(text.find('\n', start), text.size());
+            out.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    // Pass 1 over sourceText[first, last), starting in `section`: appends
+    // the statements, label definitions and the section at each line start,
+    // and returns the section in effect after the last line
+    int parseLines(size_t first, size_t last, int section, vector<Instruction> &stmts,
+                   vector<LabelDef> &defs, vector<uint8_t> &sections, int &errors) const
+    {
+        for (size_t lineIndex = first; lineIndex < last; ++lineIndex)
+        {
+            sections.push_back((uint8_t)section);
+            string_view line = trim(stripComment(sourceText[lineIndex]));
+
+            // --- Handle labels (a ':' inside a string literal is not one) ---
+            while (true)
+            {
+                size_t pos = line.find(':');
+                if (pos == string_view::npos || pos > line.find('"'))
+                    break;
+                string_view label = trim(line.substr(0, pos));
+                if (!label.empty())
+                    defs.push_back({label, (int)lineIndex, section});
+                line = trim(line.substr(pos + 1));
+            }
+            if (line.empty())
+                continue;
+
+            // --- Parse instruction or directive ---
+            size_t opEnd = min(line.find_first_of(" \t"), line.size());
+            Instruction inst;
+            inst.op = line.substr(0, opEnd);
+            inst.operands = trim(line.substr(opEnd));
+            inst.sourceLine = (int)lineIndex;
+            inst.section = section;
+            bool scanOnly = lazyAssembly && section == SECTION_TEXT && inst.op[0] != '.';
+            if (!scanOnly)
+                splitOperands(inst.operands, inst.args);
+
+            try
+            {
+                if (inst.op[0] == '.')
+                {
+                    inst.op = canonicalDirective(inst.op);
+                    if (switchSection(inst.op, inst.operands, section))
+                        continue;
+                    // .align padding depends on the offset; layout() redoes it
+                    inst.size = directiveSize(inst, 0);
+                }
+                else if (scanOnly)
+                {
+                    inst.size = scannedSize(inst);
+                    inst.pending = true;
+                }
+                else
+                {
+                    inst = expandPseudo(inst);
+                    inst.size = encodedSize(inst);
+                }
+            }
+            catch (const exception &e)
+            {
+                cerr << "[Error] Line " << lineIndex + 1 << ": " << e.what() << "\n";
+                ++errors;
+                continue;
+            }
+            stmts.push_back(inst);
+        }
+        return section;
+    }
+
+    // Assigns section offsets to every statement and label, places .data and
+    // updates the label table; returns whether any label address changed
+    bool layout(int &errors)
+    {
+        uint32_t size[2] = {0, 0};
+        size_t d = 0;
+        auto place = [&](int line)
+        {
+            for (; d < labelDefs.size() && labelDefs[d].sourceLine <= line; ++d)
+                labelDefs[d].offset = size[labelDefs[d].section];
+        };
+        for (auto &inst : program)
+        {
+            place(inst.sourceLine);
+            inst.offset = size[inst.section];
+            if (isAlignment(inst.op))
+                inst.size = directiveSize(inst, inst.offset);
+            size[inst.section] += inst.size;
+        }
+        place(numeric_limits<int>::max());
+        sectionSize[SECTION_TEXT] = size[SECTION_TEXT];
+        sectionSize[SECTION_DATA] = size[SECTION_DATA];
+
+        sreg textEnd = textBase + size[SECTION_TEXT];
+        dataBase = requestedDataBase >= 0 ? requestedDataBase : (textEnd + 15) & ~(sreg)15;
+        imageBase = size[SECTION_DATA] ? min(textBase, dataBase) : textBase;
+        if (size[SECTION_DATA] && dataBase < textEnd && textBase < dataBase + (sreg)size[SECTION_DATA])
+        {
+            cerr << "[Error] .data at 0x" << hex << dataBase << " overlaps .text at 0x" << textBase << dec << "\n";
+            ++errors;
+        }
+
+        bool moved = false;
+        for (const auto &def : labelDefs)
+        {
+            sreg addr = (def.section == SECTION_TEXT ? textBase : dataBase) + def.offset;
+            auto it = labels.find(def.name);
+            if (it == labels.end())
+                labels.emplace(string(def.name), addr);
+            else if (it->second != addr)
+                it->second = addr;
+            else
+                continue;
+            moved = true;
+        }
+        return moved;
+    }
+
+    sreg imageEnd() const
+    {
+        sreg textEnd = textBase + sectionSize[SECTION_TEXT];
+        return sectionSize[SECTION_DATA] ? max(textEnd, dataBase + (sreg)sectionSize[SECTION_DATA]) : textEnd;
+    }
+
+    sreg addressOf(const Instruction &inst) const
+    {
+        return (inst.section == SECTION_TEXT ? textBase : dataBase) + inst.offset;
+    }
+
+    // Pass 2 for one statement: its bytes in the program image
+    void encodeInto(const Instruction &inst, int &errors)
+    {
+        sreg at = addressOf(inst);
+        uint8_t *out = &image[at - imageBase];
+        bool isDirective = inst.op[0] == '.';
+        uint32_t words[MAX_LI_WORDS] = {}; // 0 is an illegal instruction
+        fill_n(out, inst.size, 0); // a failed directive leaves zeros
+        try
+        {
+            if (isDirective)
+                emitDirective(inst, out);
+            else
+                encodeStatement(inst, at, words);
+        }
+        catch (const exception &e)
+        {
+            cerr << "[Error] Line " << inst.sourceLine + 1 << ": " << e.what() << "\n";
+            ++errors;
+        }
+        if (!isDirective)
+            for (uint32_t i = 0; i < inst.size; i += 4)
+                storeWord(out + i, words[i / 4]);
+    }
+
+    // Whether a statement's bytes depend on label addresses
+    static bool refersToLabels(const Instruction &inst)
+    {
+        if (inst.op[0] == '.')
+            return !isAlignment(inst.op) && inst.op != ".SPACE" && inst.op != ".ZERO" && inst.op != ".INCBIN" &&
+                   inst.op != ".STRING" && inst.op != ".ASCIZ" && inst.op != ".ASCII";
+        if (inst.op == "LA")
+            return true;
+        Fmt fmt = opInfo(opByName(inst.op)).fmt;
+        return fmt == Fmt::B || fmt == Fmt::J;
+    }
+
+    void mapSourceLines()
+    {
+        sourceLines.assign((sectionSize[SECTION_TEXT] + 3) / 4, -1);
+        for (const auto &inst : program)
+            if (inst.section == SECTION_TEXT)
+                for (uint32_t i = 0; i < inst.size; i += 4)
+                    sourceLines[(inst.offset + i) / 4] = inst.sourceLine;
+    }
+
+    // Fresh registers, the 4 KiB data/stack region and the program image
+    void resetToImage()
+    {
+        regs = {};
+        markAllChanged();
+        memory.assign(max<size_t>(4096, ((size_t)imageEnd() + 3) & ~(size_t)3), 0);
+        copy(image.begin(), image.end(), memory.begin() + imageBase);
+        regs.x[2] = 4096; // top of 4 KB stack region
+        regs.x[3] = 2048; // gp
+        regs.pc = textBase;
+        instret = 0;
+        eventsDrained = eventsWritten;
+        reservationAddr = -1;
+        startTime = chrono::steady_clock::now();
+        resetDecodeCache();
+    }
+
+    // encodedSize() of a statement not parsed yet: every instruction but LA
+    // and LI is one word, so only LI's operands are looked at
+    static uint32_t scannedSize(Instruction &inst)
+    {
+        if (iequals(inst.op, "LA"))
+            return 8;
+        if (!iequals(inst.op, "LI"))
+            return 4;
+        splitOperands(inst.operands, inst.args);
+        return encodedSize(expandPseudo(inst));
+    }
+
+    // Lazy assembly: parses and encodes the pending .text statement covering
+    // `addr` into the image and guest memory. Its errors are reported now.
+    void assembleAt(sreg addr)
+    {
+        sreg off = addr - textBase;
+        if (off < 0 || off / 4 >= (sreg)sourceLines.size() || sourceLines[off / 4] < 0)
+            return;
+        auto it = lower_bound(program.begin(), program.end(), sourceLines[off / 4], [](const Instruction &x, int line)
+                              { return x.sourceLine < line; });
+        if (it == program.end() || !it->pending)
+            return;
+
+        Instruction &inst = *it;
+        inst.args = {};
+        splitOperands(inst.operands, inst.args);
+        inst = expandPseudo(inst);
+        inst.pending = false;
+        --pendingStatements;
+
+        int errors = 0;
+        encodeInto(inst, errors);
+        assembleErrors += errors;
+        sreg at = addressOf(inst);
+        copy_n(image.begin() + (at - imageBase), inst.size, memory.begin() + at);
+    }
+
+    // Bytes a (pseudo-expanded) statement occupies; LA becomes AUIPC + ADDI,
+    // and LI the sequence from loadImmediate()
+    static int encodedSize(const Instruction &inst)
+    {
+        if (inst.op == "LA")
+            return 8;
+        if (inst.op == "LI" && inst.args.size() == 2)
+        {
+            DecodedInst seq[MAX_LI_WORDS];
+            return 4 * loadImmediate(0, liValue(inst.args[1]), seq);
+        }
+        return 4;
+    }
+
+    // LI's constant: any 64-bit value on RV64, a 32-bit one on RV32
+    static int64_t liValue(string_view s)
+    {
+        return XLEN == 64 ? parseValue(s) : (int64_t)parseNumber(s);
+    }
+
+    // Longest LI expansion: LUI + ADDIW, then up to three SLLI + ADDI pairs
+    static constexpr int MAX_LI_WORDS = 8;
+
+    // Instructions that put `value` in rd, written to `out`; returns how many.
+    // Constants that fit in 12 bits take one ADDI, 32-bit ones LUI + ADDI
+    // (ADDIW on RV64, which re-sign-extends the 32-bit sum). Wider RV64
+    // constants build their upper bits the same way, then shift them into
+    // place and add each remaining 12-bit chunk, like GNU as and LLVM.
+    static int loadImmediate(uint8_t rd, int64_t value, DecodedInst *out)
+    {
+        int32_t lo12 = (int32_t)((value & 0xFFF) ^ 0x800) - 0x800;
+        if (XLEN == 32 || value == (int64_t)(int32_t)value)
+        {
+            uint32_t hi20 = ((uint32_t)value + 0x800) >> 12;
+            int n = 0;
+            if (hi20 & 0xFFFFF)
+                out[n++] = {Op::LUI, rd, 0, 0, (int32_t)(hi20 << 12)};
+            if (lo12 || n == 0)
+            {
+                out[n] = {n && XLEN == 64 ? Op::ADDIW : Op::ADDI, rd, (uint8_t)(n ? rd : 0), 0, lo12};
+                ++n;
+            }
+            return n;
+        }
+
+        // value = (upper << shift) + lo12, with upper odd
+        int64_t upper = (int64_t)((uint64_t)value - (uint64_t)(int64_t)lo12) >> 12;
+        int shift = 12 + countr_zero((uint64_t)upper);
+        upper >>= shift - 12;
+        int n = loadImmediate(rd, upper, out);
+        out[n++] = {Op::SLLI, rd, rd, 0, shift};
+        if (lo12)
+            out[n++] = {Op::ADDI, rd, rd, 0, lo12};
+        return n;
+    }
+
+    // Encode one statement at address `at`; throws on malformed operands
+    void encodeStatement(const Instruction &inst, sreg at, uint32_t *out) const
+    {
+        const auto &a = inst.args;
+
+        // --- LA rd, label → AUIPC rd, hi(delta); ADDI rd, rd, lo(delta) ---
+        if (inst.op == "LA")
+        {
+            expectOperands(inst, 2);
+            int rd = regNum(a[0]);
+            sreg delta = labelAddr(a[1]) - at;
+            sreg hi = (delta + 0x800) >> 12;
+            out[0] = encodeWord({Op::AUIPC, (uint8_t)rd, 0, 0, (int32_t)(hi << 12)});
+            out[1] = encodeWord({Op::ADDI, (uint8_t)rd, (uint8_t)rd, 0, (int32_t)(delta - (hi << 12))});
+            return;
+        }
+
+        // --- LI rd, imm → loadImmediate() sequence ---
+        if (inst.op == "LI")
+        {
+            expectOperands(inst, 2);
+            DecodedInst seq[MAX_LI_WORDS];
+            int n = loadImmediate((uint8_t)regNum(a[0]), liValue(a[1]), seq);
+            for (int i = 0; i < n; ++i)
+                out[i] = encodeWord(seq[i]);
+            return;
+        }
+
+        // "AMOADD.W.AQRL" → "AMOADD.W" plus the aq/rl ordering bits
+        string_view name = inst.op;
+        int ordering = 0;
+        size_t dot = name.find('.');
+        size_t suffix = dot == string_view::npos ? string_view::npos : name.find('.', dot + 1);
+        if (suffix != string_view::npos)
+        {
+            string_view bits = name.substr(suffix + 1);
+            ordering = iequals(bits, "AQRL") ? 3 : iequals(bits, "AQ") ? 2 : iequals(bits, "RL") ? 1 : -1;
+            name = name.substr(0, suffix);
+        }
+
+        Op op = opByName(name);
+        const OpInfo &info = opInfo(op);
+        if (op == Op::ILLEGAL || (XLEN == 32 && info.rv64) || (ordering && info.fmt != Fmt::AMO) || ordering < 0)
+            throw runtime_error("Unknown instruction: " + string(inst.op));
+
+        DecodedInst d;
+        d.op = op;
+        switch (info.fmt)
+        {
+        case Fmt::R:
+            expectOperands(inst, 3);
+            d.rd = regNum(a[0]);
+            d.rs1 = regNum(a[1]);
+            d.rs2 = regNum(a[2]);
+            break;
+        case Fmt::I:
+            expectOperands(inst, 3);
+            d.rd = regNum(a[0]);
+            d.rs1 = regNum(a[1]);
+            d.imm = immediate(a[2], -2048, 2047);
+            break;
+        case Fmt::SHIFT:
+        case Fmt::SHIFTW:
+            expectOperands(inst, 3);
+            d.rd = regNum(a[0]);
+            d.rs1 = regNum(a[1]);
+            d.imm = immediate(a[2], 0, info.fmt == Fmt::SHIFT ? XLEN - 1 : 31);
+            break;
+        case Fmt::L:
+            // rd, imm(rs1) — JALR also accepts rd, rs1, imm
+            if (a.size() == 3)
+            {
+                d.rd = regNum(a[0]);
+                d.rs1 = regNum(a[1]);
+                d.imm = immediate(a[2], -2048, 2047);
+                break;
+            }
+            expectOperands(inst, 2);
+            d.rd = regNum(a[0]);
+            d.imm = memOperand(a[1], d.rs1);
+            break;
+        case Fmt::S:
+            expectOperands(inst, 2);
+            d.rs2 = regNum(a[0]);
+            d.imm = memOperand(a[1], d.rs1);
+            break;
+        case Fmt::B:
+            expectOperands(inst, 3);
+            d.rs1 = regNum(a[0]);
+            d.rs2 = regNum(a[1]);
+            d.imm = branchOffset(a[2], at, 13);
+            break;
+        case Fmt::U:
+            expectOperands(inst, 2);
+            d.rd = regNum(a[0]);
+            d.imm = (int32_t)((uint32_t)immediate(a[1], -0x80000, 0xFFFFF) << 12);
+            break;
+        case Fmt::J:
+            // JAL label is JAL ra, label
+            if (a.size() == 1)
+            {
+                d.rd = 1;
+                d.imm = branchOffset(a[0], at, 21);
+                break;
+            }
+            expectOperands(inst, 2);
+            d.rd = regNum(a[0]);
+            d.imm = branchOffset(a[1], at, 21);
+            break;
+        case Fmt::AMO:
+            // LR rd, (rs1) | SC/AMO rd, rs2, (rs1)
+            if (op == Op::LR_W || op == Op::LR_D)
+            {
+                expectOperands(inst, 2);
+                d.rd = regNum(a[0]);
+                memOperand(a[1], d.rs1);
+            }
+            else
+            {
+                expectOperands(inst, 3);
+                d.rd = regNum(a[0]);
+                d.rs2 = regNum(a[1]);
+                memOperand(a[2], d.rs1);
+            }
+            d.imm = ordering;
+            break;
+        case Fmt::CSR:
+            expectOperands(inst, 3);
+            d.rd = regNum(a[0]);
+            d.imm = csrNum(a[1]);
+            d.rs1 = regNum(a[2]);
+            break;
+        case Fmt::CSRI:
+            expectOperands(inst, 3);
+            d.rd = regNum(a[0]);
+            d.imm = csrNum(a[1]);
+            d.rs1 = immediate(a[2], 0, 31);
+            break;
+        case Fmt::SYS:
+            // FENCE operands are ignored: always a full iorw, iorw fence
+            d.imm = op == Op::FENCE ? 0x0FF : 0;
+            break;
+        }
+        out[0] = encodeWord(d);
+    }
+
+    static void expectOperands(const Instruction &inst, size_t n)
+    {
+        if (inst.args.size() != n)
+            throw runtime_error(string(inst.op) + " expects " + to_string(n) + " operands, got " + to_string(inst.args.size()));
+    }
+
+    static int immediate(string_view s, int lo, int hi)
+    {
+        int v = parseNumber(s);
+        if (v < lo || v > hi)
+            throw runtime_error("Immediate out of range [" + to_string(lo) + ", " + to_string(hi) + "]: " + string(s));
+        return v;
+    }
+
+    // "imm(rs1)" → imm, with rs1 written to `rs1`
+    int memOperand(string_view s, uint8_t &rs1) const
+    {
+        auto [imm, rs] = parseMem(s);
+        if (imm < -2048 || imm > 2047)
+            throw runtime_error("Offset out of range [-2048, 2047]: " + string(s));
+        rs1 = (uint8_t)rs;
+        return imm;
+    }
+
+    sreg labelAddr(string_view label) const
+    {
+        auto it = labels.find(label);
+        if (it == labels.end())
+            throw runtime_error("Undefined label: " + string(label));
+        return it->second;
+    }
+
+    // PC-relative target of a branch/jump: a label or a numeric byte offset
+    int branchOffset(string_view target, sreg at, int bits) const
+    {
+        bool numeric = !target.empty() && (isdigit((unsigned char)target[0]) || target[0] == '-' || target[0] == '+');
+        sreg offset = numeric ? parseNumber(target) : labelAddr(target) - at;
+        sreg limit = (sreg)1 << (bits - 1);
+        if (offset < -limit || offset >= limit || (offset & 1))
+            throw runtime_error("Branch target out of range: " + string(target));
+        return (int)offset;
+    }
+
+    // Little-endian word write into the program image
+    static void storeWord(uint8_t *p, uint32_t w)
+    {
+        p[0] = (uint8_t)w;
+        p[1] = (uint8_t)(w >> 8);
+        p[2] = (uint8_t)(w >> 16);
+        p[3] = (uint8_t)(w >> 24);
+    }
+
+    //---------------------------------
+    // Assembler directives
+    //---------------------------------
+    // "# comment" removal that leaves '#' inside string literals alone
+    static string_view stripComment(string_view line)
+    {
+        bool quoted = false;
+        for (size_t i = 0; i < line.size(); ++i)
+        {
+            if (line[i] == '"' && (i == 0 || line[i - 1] != '\\'))
+                quoted = !quoted;
+            else if (line[i] == '#' && !quoted)
+                return line.substr(0, i);
+        }
+        return line;
+    }
+
+    // "a0, 8(sp)" → {"a0", "8(sp)"}; commas and blanks both separate
+    static void splitOperands(string_view s, Operands &out)
+    {
+        forEachOperand(s, [&](string_view arg)
+                       { out.push_back(arg); });
+    }
+
+    template <typename F>
+    static void forEachOperand(string_view s, F fn)
+    {
+        const char *separators = " \t\r,";
+        for (size_t i = s.find_first_not_of(separators); i != string_view::npos; i = s.find_first_not_of(separators, i))
+        {
+            size_t end = min(s.find_first_of(separators, i), s.size());
+            fn(s.substr(i, end - i));
+            i = end;
+        }
+    }
+
+    // Directive names are matched ignoring case and kept in upper case
+    static string_view canonicalDirective(string_view op)
+    {
+        static constexpr NameValue names[] = {
+            {".TEXT", 0}, {".DATA", 0}, {".RODATA", 0}, {".BSS", 0}, {".SECTION", 0}, {".GLOBL", 0}, {".GLOBAL", 0},
+            {".WORD", 0}, {".LONG", 0}, {".HALF", 0}, {".SHORT", 0}, {".BYTE", 0}, {".DWORD", 0}, {".QUAD", 0},
+            {".STRING", 0}, {".ASCIZ", 0}, {".ASCII", 0}, {".INCBIN", 0}, {".SPACE", 0}, {".ZERO", 0},
+            {".ALIGN", 0}, {".P2ALIGN", 0}, {".BALIGN", 0}};
+        static constexpr auto table = makeNameTable(names);
+        const NameValue *e = table.lookup(op);
+        return e ? e->name : op;
+    }
+
+    // .text / .data / .section name; returns false for any other directive
+    static bool switchSection(string_view op, string_view args, int &section)
+    {
+        if (op == ".TEXT")
+            section = SECTION_TEXT;
+        else if (op == ".DATA" || op == ".RODATA" || op == ".BSS")
+            section = SECTION_DATA;
+        else if (op == ".SECTION")
+            section = args.compare(0, 5, ".text") == 0 ? SECTION_TEXT : SECTION_DATA;
+        else if (op == ".GLOBL" || op == ".GLOBAL")
+            ; // every label is visible already
+        else
+            return false;
+        return true;
+    }
+
+    // Decodes the "quoted" strings of .string/.ascii into `out` when given,
+    // returning the byte count; .string/.asciz add a NUL to each
+    static uint32_t stringBytes(string_view s, bool terminate, uint8_t *out)
+    {
+        uint32_t n = 0;
+        size_t i = 0;
+        while ((i = s.find('"', i)) != string_view::npos)
+        {
+            for (++i; i < s.size() && s[i] != '"'; ++i, ++n)
+            {
+                char c = s[i];
+                if (c == '\\' && i + 1 < s.size())
+                {
+                    char e = s[++i];
+                    c = e == 'n' ? '\n' : e == 't' ? '\t' : e == 'r' ? '\r' : e == '0' ? '\0' : e;
+                }
+                if (out)
+                    out[n] = (uint8_t)c;
+            }
+            if (i >= s.size())
+                throw runtime_error("Unterminated string");
+            ++i;
+            if (terminate)
+            {
+                if (out)
+                    out[n] = 0;
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    // .incbin "path"[, skip[, count]]: opens the host file at `skip` and
+    // clips `count` to what the file holds
+    static ifstream openIncbin(const Operands &a, size_t &count)
+    {
+        if (a.empty())
+            throw runtime_error(".incbin expects a file name");
+        string_view path = a[0];
+        if (path.size() >= 2 && path.front() == '"' && path.back() == '"')
+            path = path.substr(1, path.size() - 2);
+        ifstream in(string(path), ios::binary | ios::ate);
+        if (!in)
+            throw runtime_error("Cannot open .incbin file: " + string(path));
+        size_t fileSize = (size_t)in.tellg();
+        size_t skip = min(a.size() > 1 ? (size_t)parseNumber(a[1]) : 0, fileSize);
+        count = min(a.size() > 2 ? (size_t)parseNumber(a[2]) : fileSize, fileSize - skip);
+        in.seekg(skip);
+        return in;
+    }
+
+    // Bytes a directive occupies when it starts at `offset` in its section
+    static uint32_t directiveSize(const Instruction &inst, uint32_t offset)
+    {
+        string_view op = inst.op;
+        const auto &a = inst.args;
+        if (op == ".WORD" || op == ".LONG")
+            return 4 * a.size();
+        if (op == ".HALF" || op == ".SHORT")
+            return 2 * a.size();
+        if (op == ".BYTE")
+            return a.size();
+        if (op == ".DWORD" || op == ".QUAD")
+            return 8 * a.size();
+        if (op == ".STRING" || op == ".ASCIZ" || op == ".ASCII")
+            return stringBytes(inst.operands, op != ".ASCII", nullptr);
+        if (op == ".INCBIN")
+        {
+            size_t count;
+            openIncbin(a, count);
+            return count;
+        }
+        if (op == ".SPACE" || op == ".ZERO")
+        {
+            if (a.empty() || parseNumber(a[0]) < 0)
+                throw runtime_error(string(op) + " expects a non-negative size");
+            return parseNumber(a[0]);
+        }
+        if (isAlignment(op))
+        {
+            // .align/.p2align take a power of two, .balign a byte count
+            int n = a.empty() ? 0 : parseNumber(a[0]);
+            uint32_t align = op == ".BALIGN" ? (uint32_t)n : 1u << n;
+            if (n < 0 || n > 30 || align == 0 || (align & (align - 1)))
+                throw runtime_error("Bad alignment: " + string(a.empty() ? string_view() : a[0]));
+            return (align - offset % align) % align;
+        }
+        throw runtime_error("Unknown directive: " + string(op));
+    }
+
+    static bool isAlignment(string_view op)
+    {
+        return op == ".ALIGN" || op == ".P2ALIGN" || op == ".BALIGN";
+    }
+
+    // Writes a directive's bytes to `out`
+    void emitDirective(const Instruction &inst, uint8_t *out) const
+    {
+        string_view op = inst.op;
+        const auto &a = inst.args;
+        if (op == ".STRING" || op == ".ASCIZ" || op == ".ASCII")
+        {
+            stringBytes(inst.operands, op != ".ASCII", out);
+            return;
+        }
+        if (op == ".INCBIN")
+        {
+            size_t count;
+            openIncbin(a, count).read(reinterpret_cast<char *>(out), min<size_t>(count, inst.size));
+            return;
+        }
+        if (op == ".SPACE" || op == ".ZERO")
+        {
+            if (a.size() > 1)
+                fill_n(out, inst.size, (uint8_t)parseNumber(a[1]));
+            return;
+        }
+        if (isAlignment(op))
+            return; // padding stays zero
+
+        // .byte/.half/.word/.dword: numbers or label addresses
+        int width = op == ".BYTE" ? 1 : (op == ".HALF" || op == ".SHORT") ? 2 : (op == ".DWORD" || op == ".QUAD") ? 8 : 4;
+        forEachOperand(inst.operands, [&](string_view v)
+                       {
+            auto it = labels.find(v);
+            int64_t value = it != labels.end() ? it->second : width == 8 ? parseValue(v) : parseNumber(v);
+            if (width < 4 && (value < -(1 << (8 * width - 1)) || value >= (1 << (8 * width))))
+                throw runtime_error("Value does not fit in " + string(op) + ": " + string(v));
+            for (int i = 0; i < width; ++i)
+                *out++ = (uint8_t)(value >> (8 * i)); });
+    }
+
+    //--- Pseudo Helpers
+    // Rewrites `inst` as `op args...`, keeping its source line
+    static Instruction rewrite(const Instruction &inst, string_view op, initializer_list<string_view> args)
+    {
+        Instruction out = inst;
+        out.op = op;
+        out.args = {};
+        for (string_view arg : args)
+            out.args.push_back(arg);
+        return out;
+    }
+
+    // Every pseudo-instruction becomes one real statement; LA and LI are
+    // expanded to their instruction pairs when encoded
+    static Instruction expandPseudo(const Instruction &inst)
+    {
+        string_view op = inst.op;
+        const auto &a = inst.args;
+
+        // --- MV rd, rs → ADDI rd, rs, 0 ---
+        if (iequals(op, "MV") && a.size() == 2)
+            return rewrite(inst, "ADDI", {a[0], a[1], "0"});
+
+        // --- LI rd, imm / LA rd, label: only the name is normalized here ---
+        if (iequals(op, "LI") || iequals(op, "LA"))
+        {
+            Instruction named = inst;
+            named.op = iequals(op, "LI") ? "LI" : "LA";
+            return named;
+        }
+
+        // --- J label ---
+        if (iequals(op, "J") && a.size() == 1)
+            return rewrite(inst, "JAL", {"x0", a[0]});
+
+        // --- JR rs ---
+        if (iequals(op, "JR") && a.size() == 1)
+            return rewrite(inst, "JALR", {"x0", a[0], "0"});
+
+        // --- RET ---
+        if (iequals(op, "RET"))
+            return rewrite(inst, "JALR", {"x0", "x1", "0"});
+
+        // --- RDCYCLE/RDTIME/RDINSTRET[H] rd → CSRRS rd, csr, x0 ---
+        if (op.size() > 2 && iequals(op.substr(0, 2), "RD") && a.size() == 1)
+        {
+            string_view csr = op.substr(2);
+            if (CSR_NAME_TABLE.find(csr) >= 0)
+                return rewrite(inst, "CSRRS", {a[0], csr, "x0"});
+        }
+
+        // --- CSRR rd, csr → CSRRS rd, csr, x0 ---
+        if (iequals(op, "CSRR") && a.size() == 2)
+            return rewrite(inst, "CSRRS", {a[0], a[1], "x0"});
+
+        // --- CSRW/CSRS/CSRC[I] csr, src → CSRRx[I] x0, csr, src ---
+        static constexpr string_view csrPseudo[][2] = {
+            {"CSRW", "CSRRW"}, {"CSRS", "CSRRS"}, {"CSRC", "CSRRC"},
+            {"CSRWI", "CSRRWI"}, {"CSRSI", "CSRRSI"}, {"CSRCI", "CSRRCI"}};
+        for (const auto &[pseudo, real] : csrPseudo)
+            if (iequals(op, pseudo) && a.size() == 2)
+                return rewrite(inst, real, {"x0", a[0], a[1]});
+
+        // --- Default (unchanged) ---
+        return inst;
+    }
+};
+
+using SimpleRISCV = RiscvCore<RISCV_XLEN>;
@@ -0,0 +1,193 @@
+// Cycle-approximate timing for a classic 5-stage in-order pipeline
+// (IF ID EX MEM WB), attached to a core through RiscvCore::timing. It only
+// watches retired instructions, so it works with any engine and costs
+// nothing when detached.
+#pragma once
+
+#include "riscv_core.h"
+
+struct PipelineConfig
+{
+    uint32_t loadLatency = 1;       // MEM cycles of a load, store or AMO
+    uint32_t loadUsePenalty = 1;    // bubbles before a load result reaches EX
+    uint32_t mulLatency = 3;        // EX cycles of MUL*
+    uint32_t divLatency = 20;       // EX cycles of DIV*, REM*
+    uint32_t mispredictPenalty = 2; // taken branch or JALR, resolved in EX
+    uint32_t jumpPenalty = 1;       // JAL, resolved in ID
+    bool forwarding = true;         // EX/MEM and MEM/WB bypasses
+};
+
+// Branches are predicted not taken, so every taken branch pays the
+// mispredict penalty. Without forwarding a result reaches EX the cycle
+// after WB (the register file writes in the first half of a cycle and is
+// read in the second). Mul/div units are not pipelined.
+class PipelineModel : public TimingModel
+{
+public:
+    PipelineConfig config;
+
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;            // WB cycle of the last instruction
+    uint64_t dataStalls = 0;        // waiting for operands
+    uint64_t structuralStalls = 0;  // multi-cycle EX or MEM ahead
+    uint64_t controlStalls = 0;     // fetch redirects
+
+    explicit PipelineModel(const PipelineConfig &c = {}) : config(c) { reset(); }
+
+    void reset() override
+    {
+        instructions = cycles = 0;
+        dataStalls = structuralStalls = controlStalls = 0;
+        nextEx = FIRST_EX;
+        ready.fill(0);
+    }
+
+    void retire(const DecodedInst &d, bool redirect) override
+    {
+        const Fmt fmt = opInfo(d.op).fmt;
+        ++instructions;
+
+        // Data hazards: EX waits for both operands. Store data is needed
+        // a cycle later, in MEM.
+        uint64_t ex = nextEx;
+        if (readsRs1(fmt))
+            ex = max(ex, ready[d.rs1]);
+        if (readsRs2(fmt))
+            ex = max(ex, fmt == Fmt::S && config.forwarding && ready[d.rs2] ? ready[d.rs2] - 1 : ready[d.rs2]);
+        dataStalls += ex - nextEx;
+
+        const bool memAccess = (fmt == Fmt::L && d.op != Op::JALR) || fmt == Fmt::S || fmt == Fmt::AMO;
+        const uint64_t exEnd = ex + execCycles(d.op) - 1;
+        const uint64_t memEnd = exEnd + (memAccess ? max(config.loadLatency, 1u) : 1);
+        cycles = memEnd + 1;
+
+        if (writesRd(fmt) && d.rd != 0)
+        {
+            if (!config.forwarding)
+                ready[d.rd] = cycles + 1;
+            else if (memAccess)
+                ready[d.rd] = memEnd + config.loadUsePenalty;
+            else
+                ready[d.rd] = exEnd + 1;
+        }
+
+        // The next instruction follows once EX is free and its MEM cycle
+        // comes after this one's
+        nextEx = max(exEnd + 1, memEnd);
+        structuralStalls += nextEx - (ex + 1);
+
+        if (redirect && (fmt == Fmt::B || fmt == Fmt::J || d.op == Op::JALR))
+        {
+            uint32_t penalty = fmt == Fmt::J ? config.jumpPenalty : config.mispredictPenalty;
+            nextEx += penalty;
+            controlStalls += penalty;
+        }
+    }
+
+    uint64_t cycleCount() const override { return cycles; }
+
+    double cpi() const { return instructions ? (double)cycles / instructions : 0.0; }
+
+    // Comma-separated key=value settings: load, load-use, mul, div,
+    // mispredict, jump, forwarding (0/1). Unknown keys or bad values leave
+    // the config unchanged and return false.
+    bool configure(string_view spec)
+    {
+        PipelineConfig c = config;
+        while (!spec.empty())
+        {
+            size_t comma = spec.find(',');
+            string_view item = spec.substr(0, comma);
+            spec = comma == string_view::npos ? string_view() : spec.substr(comma + 1);
+            if (item.empty())
+                continue;
+
+            size_t eq = item.find('=');
+            if (eq == string_view::npos)
+                return false;
+            string_view key = item.substr(0, eq), text = item.substr(eq + 1);
+            uint32_t value;
+            auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+            if (ec != errc() || end != text.data() + text.size())
+                return false;
+
+            if (key == "load")
+                c.loadLatency = max(value, 1u);
+            else if (key == "load-use")
+                c.loadUsePenalty = value;
+            else if (key == "mul")
+                c.mulLatency = max(value, 1u);
+            else if (key == "div")
+                c.divLatency = max(value, 1u);
+            else if (key == "mispredict")
+                c.mispredictPenalty = value;
+            else if (key == "jump")
+                c.jumpPenalty = value;
+            else if (key == "forwarding")
+                c.forwarding = value != 0;
+            else
+                return false;
+        }
+        config = c;
+        return true;
+    }
+
+    // Same layout as riscv-run's statistics
+    string report() const
+    {
+        ostringstream out;
+        out << "cycles        " << cycles << "\n"
+            << "CPI           " << fixed << setprecision(3) << cpi() << "\n"
+            << "stalls        data " << dataStalls << ", structural " << structuralStalls
+            << ", control " << controlStalls << "\n"
+            << "pipeline      load " << config.loadLatency << ", load-use " << config.loadUsePenalty
+            << ", mul " << config.mulLatency << ", div " << config.divLatency
+            << ", mispredict " << config.mispredictPenalty << ", jump " << config.jumpPenalty
+            << ", forwarding " << (config.forwarding ? "on" : "off") << "\n";
+        return out.str();
+    }
+
+private:
+    // IF in cycle 1, ID in 2, so the first instruction reaches EX in 3
+    static constexpr uint64_t FIRST_EX = 3;
+
+    uint64_t nextEx = FIRST_EX;
+    array<uint64_t, 32> ready{}; // first cycle each register's value can enter EX
+
+    static bool readsRs1(Fmt fmt)
+    {
+        return fmt != Fmt::U && fmt != Fmt::J && fmt != Fmt::CSRI && fmt != Fmt::SYS;
+    }
+    static bool readsRs2(Fmt fmt)
+    {
+        return fmt == Fmt::R || fmt == Fmt::S || fmt == Fmt::B || fmt == Fmt::AMO;
+    }
+    static bool writesRd(Fmt fmt)
+    {
+        return fmt != Fmt::S && fmt != Fmt::B && fmt != Fmt::SYS;
+    }
+
+    uint32_t execCycles(Op op) const
+    {
+        switch (op)
+        {
+        case Op::MUL:
+        case Op::MULH:
+        case Op::MULHSU:
+        case Op::MULHU:
+        case Op::MULW:
+            return max(config.mulLatency, 1u);
+        case Op::DIV:
+        case Op::DIVU:
+        case Op::REM:
+        case Op::REMU:
+        case Op::DIVW:
+        case Op::DIVUW:
+        case Op::REMW:
+        case Op::REMUW:
+            return max(config.divLatency, 1u);
+        default:
+            return 1;
+        }
+    }
+};
@@ -0,0 +1,245 @@
+// riscv-run: runs a program on the native build of the core and prints the
+// final state and run statistics; see the README for build commands.
+#include "riscv_pipeline.h"
+
+static const char USAGE[] =
+    "usage: riscv-run [options] <program>\n"
+    "  <program>        assembly source, an ELF executable, or raw code (*.bin)\n"
+    "  --engine=batch   timed batches without per-instruction events (default)\n"
+    "  --engine=step    one step() per instruction, events drained as it goes\n"
+    "  --max=N          stop after N instructions (default: no limit)\n"
+    "  --trace          print each executed instruction and branch (step engine)\n"
+    "  --base=ADDR      load address of raw code (default 0)\n"
+    "  --lazy           assemble each instruction when first used\n"
+    "  --cache=DIR      reuse assembled programs stored in DIR\n"
+    "  --profile        count executions per PC; report hot functions and lines\n"
+    "  --mix=FILE       write the instruction-class and opcode mix as JSON (- = stdout)\n"
+    "  --pipeline[=K=N,...]  estimate cycles on a 5-stage in-order pipeline; keys:\n"
+    "                   load, load-use, mul, div, mispredict, jump, forwarding (0/1)\n"
+    "  --quiet          statistics only, no register and memory dump\n";
+
+// Source lines listed by --profile
+static constexpr size_t PROFILE_TOP_LINES = 10;
+
+// Step-engine events are drained this often, well before the ring fills
+// (each step records at most an EXEC and a BRANCH)
+static constexpr uint64_t DRAIN_INTERVAL = SimpleRISCV::EVENT_RING_SIZE / 4;
+
+static void printEvents(SimpleRISCV &cpu)
+{
+    size_t count = cpu.drainEvents();
+    const Event *events = cpu.getEventsPtr();
+    char line[EVENT_TEXT_MAX + 1];
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t n = formatEvent(events[i], line);
+        line[n++] = '\n';
+        cerr.write(line, n);
+    }
+}
+
+static void printProfile(const SimpleRISCV &cpu)
+{
+    uint64_t total = 0;
+    for (uint64_t n : cpu.pcCounts)
+        total += n;
+    if (!total)
+        return;
+
+    cout << "\nfunctions\n";
+    for (const auto &f : cpu.profileByFunction())
+        cout << setw(14) << f.count << setw(7) << fixed << setprecision(1) << 100.0 * f.count / total << "%  "
+             << f.name << " (0x" << hex << f.start << dec << ")\n";
+
+    vector<uint64_t> lines = cpu.profileByLine();
+    vector<size_t> order;
+    for (size_t i = 0; i < lines.size(); ++i)
+        if (lines[i])
+            order.push_back(i);
+    size_t top = min(order.size(), PROFILE_TOP_LINES);
+    partial_sort(order.begin(), order.begin() + top, order.end(), [&](size_t a, size_t b)
+                 { return lines[a] != lines[b] ? lines[a] > lines[b] : a < b; });
+    if (top)
+        cout << "\nhottest lines\n";
+    for (size_t i = 0; i < top; ++i)
+    {
+        size_t line = order[i];
+        cout << setw(14) << lines[line] << setw(7) << 100.0 * lines[line] / total << "%  line " << line + 1;
+        if (line < cpu.sourceText.size())
+        {
+            string_view text = cpu.sourceText[line];
+            text.remove_prefix(min(text.find_first_not_of(" \t"), text.size()));
+            text = text.substr(0, text.find_last_not_of(" \t\r") + 1);
+            cout << ": " << text;
+        }
+        cout << "\n";
+    }
+}
+
+// {"instructions":N,"classes":{"alu":N,...},"opcodes":{"addi":N,...}};
+// opcodes that never ran are left out
+static void writeMix(const SimpleRISCV &cpu, ostream &out)
+{
+    auto mix = cpu.instructionMix();
+    out << "{\"instructions\":" << cpu.instret << ",\"classes\":{";
+    for (size_t i = 0; i < (size_t)InstClass::COUNT; ++i)
+        out << (i ? "," : "") << '"' << INST_CLASS_NAMES[i] << "\":" << mix.byClass[i];
+    out << "},\"opcodes\":{";
+    bool first = true;
+    for (size_t i = 0; i < (size_t)Op::COUNT; ++i)
+        if (mix.byOp[i])
+        {
+            out << (first ? "" : ",") << '"' << OP_INFO[i].name << "\":" << mix.byOp[i];
+            first = false;
+        }
+    out << "}}\n";
+}
+
+static bool readFile(const string &path, string &out)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+        return false;
+    out.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    string engine = "batch", cacheDir, mixPath, path;
+    uint64_t maxInstructions = 0;
+    int64_t base = 0;
+    bool trace = false, lazy = false, quiet = false, profile = false, timed = false;
+    PipelineModel pipeline;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        auto value = [&](string_view name) -> const char *
+        {
+            return arg.substr(0, name.size()) == name ? argv[i] + name.size() : nullptr;
+        };
+        if (const char *v = value("--engine="))
+            engine = v;
+        else if (const char *v = value("--max="))
+            maxInstructions = strtoull(v, nullptr, 0);
+        else if (const char *v = value("--base="))
+            base = strtoll(v, nullptr, 0);
+        else if (const char *v = value("--cache="))
+            cacheDir = v;
+        else if (const char *v = value("--mix="))
+            mixPath = v;
+        else if (const char *v = value("--pipeline="))
+        {
+            if (!pipeline.configure(v))
+            {
+                cerr << "[Error] Bad pipeline setting: " << v << "\n";
+                return 2;
+            }
+            timed = true;
+        }
+        else if (arg == "--pipeline")
+            timed = true;
+        else if (arg == "--trace")
+            trace = true;
+        else if (arg == "--lazy")
+            lazy = true;
+        else if (arg == "--quiet")
+            quiet = true;
+        else if (arg == "--profile")
+            profile = true;
+        else if (arg[0] != '-' && path.empty())
+            path = arg;
+        else
+        {
+            cerr << USAGE;
+            return 2;
+        }
+    }
+    if (path.empty() || (engine != "batch" && engine != "step"))
+    {
+        cerr << USAGE;
+        return 2;
+    }
+
+    // --- Load ---
+    SimpleRISCV cpu;
+    cpu.profiling = profile || !mixPath.empty();
+    if (timed)
+        cpu.timing = &pipeline;
+    auto loadStart = chrono::steady_clock::now();
+    string bytes;
+    if (!readFile(path, bytes))
+    {
+        cerr << "[Error] Cannot open " << path << "\n";
+        return 1;
+    }
+    if (bytes.compare(0, 4, "\x7F" "ELF") == 0)
+    {
+        if (!cpu.loadElf(path))
+            return 1;
+    }
+    else if (path.size() > 4 && path.compare(path.size() - 4, 4, ".bin") == 0)
+        cpu.loadBinary(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), base);
+    else
+    {
+        cpu.lazyAssembly = lazy;
+        if (!cacheDir.empty())
+            cpu.loadProgramCached(move(bytes), cacheDir);
+        else
+            cpu.loadProgram(move(bytes));
+    }
+    double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+
+    // --- Run ---
+    const uint64_t limit = maxInstructions ? cpu.instret + maxInstructions : 0;
+    bool running = true;
+    auto runStart = chrono::steady_clock::now();
+    if (engine == "batch")
+    {
+        cpu.traceExec = false;
+        while (running && (!limit || cpu.instret < limit))
+            running = cpu.runFor(numeric_limits<uint32_t>::max(), limit ? limit - cpu.instret : 0);
+    }
+    else
+    {
+        cpu.traceExec = trace;
+        for (uint64_t n = 1; running && (!limit || cpu.instret < limit); ++n)
+        {
+            running = cpu.step();
+            if (n % DRAIN_INTERVAL == 0)
+                printEvents(cpu);
+        }
+    }
+    double runSec = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+    printEvents(cpu);
+
+    // --- Report ---
+    if (!quiet)
+        cout << cpu.dumpState() << "\n";
+    cout << "engine        " << engine << "\n"
+         << "stopped       " << (running ? "instruction limit" : "halted") << "\n"
+         << "instructions  " << cpu.instret << "\n"
+         << fixed << setprecision(3)
+         << "load time     " << loadMs << " ms\n"
+         << "run time      " << runSec * 1e3 << " ms\n"
+         << setprecision(1)
+         << "rate          " << (runSec > 0 ? cpu.instret / runSec / 1e6 : 0.0) << " MIPS\n";
+    if (timed)
+        cout << pipeline.report();
+    if (profile)
+        printProfile(cpu);
+    if (mixPath == "-")
+        writeMix(cpu, cout);
+    else if (!mixPath.empty())
+    {
+        ofstream out(mixPath);
+        if (!out)
+        {
+            cerr << "[Error] Cannot write " << mixPath << "\n";
+            return 1;
+        }
+        writeMix(cpu, out);
+    }
+    return 0;
+}
@@ -0,0 +1,257 @@
+#!/usr/bin/env node
+// Headless runner for the web build: loads riscv.js / riscv.wasm in Node,
+// runs a program through the same exported API the page uses and reports
+// module instantiation time, throughput and peak wasm heap. The native
+// counterpart is riscv_run.cpp; see the README.
+"use strict";
+
+const fs = require("fs");
+const path = require("path");
+const { performance } = require("perf_hooks");
+
+const USAGE = `usage: node riscv_run_node.js [options] <program>
+  <program>        assembly source, an ELF executable, or raw code (*.bin)
+  --module=PATH    Emscripten build to load (default: riscv.js next to this script)
+  --engine=batch   jsRunFor() slices without per-instruction events (default)
+  --engine=step    one jsStep() call per instruction
+  --max=N          stop after N instructions (default: no limit)
+  --trace          print each executed instruction and branch (step engine)
+  --base=ADDR      load address of raw code (default 0)
+  --lazy           assemble each instruction when first used
+  --cache=DIR      reuse assembled programs stored in DIR
+  --profile        count executions per PC; report hot functions and lines
+  --mix=FILE       write the instruction-class and opcode mix as JSON (- = stdout)
+  --pipeline[=K=N,...]  estimate cycles on a 5-stage in-order pipeline; keys:
+                   load, load-use, mul, div, mispredict, jump, forwarding (0/1)
+  --quiet          statistics only, no register and memory dump`;
+
+// Wall time per jsRunFor() call; long enough that the call itself is noise
+const SLICE_US = 100000;
+// Step-engine events are drained this often, well before the core's ring fills
+const DRAIN_INTERVAL = 1024;
+const MAX_U32 = 0xffffffff;
+
+// Mirrors of the core's RunState and EventKind values
+const RUN_RUNNING = 1;
+const EVENT_SIZE = 32;
+const EVENT_BRANCH = 1;
+
+// Source lines listed by --profile
+const PROFILE_TOP_LINES = 10;
+
+// Bindings this runner calls; a module built from older sources lacks some
+const REQUIRED_BINDINGS = [
+  "jsLoadProgram", "jsLoadProgramLazy", "jsLoadBinary", "jsLoadElf", "jsProgramCacheKey",
+  "jsLoadCachedProgram", "jsSaveProgramCache", "jsProgramCacheData", "jsStep", "jsRunFor",
+  "jsDrainEvents", "jsEventsPtr", "jsFormatEvents", "jsTextData", "jsDumpState", "jsInstret",
+  "jsSetProfiling", "jsProfileLines", "jsProfileData", "jsProfileFunctions",
+  "jsInstructionMix", "jsMixData", "jsMixNames", "jsSetPipeline", "jsPipelineReport",
+];
+
+function parseArgs(argv) {
+  const opts = {
+    module: path.join(__dirname, "riscv.js"),
+    engine: "batch",
+    max: 0,
+    base: 0,
+    trace: false,
+    lazy: false,
+    quiet: false,
+    cache: null,
+    profile: false,
+    mix: null,
+    pipeline: null,
+    program: null,
+  };
+  for (const arg of argv) {
+    const [name, value] = arg.split(/=(.*)/s);
+    if (name === "--module" && value) opts.module = value;
+    else if (name === "--engine" && (value === "batch" || value === "step")) opts.engine = value;
+    else if (name === "--max" && value) opts.max = Number(value);
+    else if (name === "--base" && value) opts.base = Number(value);
+    else if (arg === "--trace") opts.trace = true;
+    else if (arg === "--lazy") opts.lazy = true;
+    else if (arg === "--quiet") opts.quiet = true;
+    else if (name === "--cache" && value) opts.cache = value;
+    else if (arg === "--profile") opts.profile = true;
+    else if (name === "--mix" && value) opts.mix = value;
+    else if (name === "--pipeline") opts.pipeline = value ?? "";
+    else if (!arg.startsWith("-") && opts.program === null) opts.program = arg;
+    else return null;
+  }
+  return opts.program === null ? null : opts;
+}
+
+// Same entries as riscv-run --cache (DIR/<key>.rvpc), so both can share a
+// directory when they are built for the same XLEN
+function loadProgramCached(Module, src, opts) {
+  const key = Module.jsProgramCacheKey(src);
+  const file = path.join(opts.cache, `${key}.rvpc`);
+  if (fs.existsSync(file) && Module.jsLoadCachedProgram(src, key, fs.readFileSync(file))) return;
+
+  if (opts.lazy) Module.jsLoadProgramLazy(src);
+  else Module.jsLoadProgram(src);
+  const size = Module.jsSaveProgramCache(key);
+  if (size) {
+    // write-then-rename so a concurrent reader never sees half an entry
+    const ptr = Module.jsProgramCacheData();
+    const tmp = `${file}.${process.pid}`;
+    fs.mkdirSync(opts.cache, { recursive: true });
+    fs.writeFileSync(tmp, Module.HEAPU8.subarray(ptr, ptr + size));
+    fs.renameSync(tmp, file);
+  }
+}
+
+// Hot functions and source lines, in riscv-run --profile's layout
+function printProfile(Module, coreText, src) {
+  const functions = coreText(Module.jsProfileFunctions()).split("\n").filter(Boolean).map((row) => row.split("\t"));
+  const total = functions.reduce((sum, [count]) => sum + Number(count), 0);
+  if (!total) return;
+  const pct = (n) => `${((100 * n) / total).toFixed(1).padStart(7)}%`;
+
+  console.log("\nfunctions");
+  for (const [count, start, name] of functions) console.log(`${count.padStart(14)}${pct(count)}  ${name} (${start})`);
+
+  const count = Module.jsProfileLines();
+  const lines = new Float64Array(Module.HEAPU8.buffer, Module.jsProfileData(), count).slice();
+  const hottest = [...lines.keys()].filter((i) => lines[i]).sort((a, b) => lines[b] - lines[a]).slice(0, PROFILE_TOP_LINES);
+  if (hottest.length) console.log("\nhottest lines");
+  const text = src.split("\n");
+  for (const i of hottest) {
+    const source = i < text.length ? `: ${text[i].trim()}` : "";
+    console.log(`${String(lines[i]).padStart(14)}${pct(lines[i])}  line ${i + 1}${source}`);
+  }
+}
+
+// riscv-run --mix's JSON; opcodes that never ran are left out
+function mixJson(Module, coreText, instret) {
+  const [classText, opText] = coreText(Module.jsMixNames()).split("\n\n");
+  const classNames = classText.split("\n");
+  const opNames = opText.split("\n").slice(0, -1);
+  const count = Module.jsInstructionMix();
+  const mix = new Float64Array(Module.HEAPU8.buffer, Module.jsMixData(), count).slice();
+  const classes = Object.fromEntries(classNames.map((name, i) => [name, mix[i]]));
+  const opcodes = Object.fromEntries(opNames.map((name, i) => [name, mix[classNames.length + i]]).filter(([, n]) => n));
+  return JSON.stringify({ instructions: instret, classes, opcodes }) + "\n";
+}
+
+async function main() {
+  const opts = parseArgs(process.argv.slice(2));
+  if (!opts) {
+    console.error(USAGE);
+    process.exit(2);
+  }
+
+  // --- Instantiate ---
+  const createRiscvModule = require(path.resolve(opts.module));
+  const instantiateStart = performance.now();
+  const Module = await createRiscvModule({
+    print: (msg) => process.stdout.write(msg + "\n"),
+    printErr: (msg) => process.stderr.write(msg + "\n"),
+  });
+  const instantiateMs = performance.now() - instantiateStart;
+  let peakHeap = Module.HEAPU8.length;
+
+  // Text at jsTextData(); views of a shared heap (-pthread) are copied
+  // because TextDecoder rejects them
+  const textDecoder = new TextDecoder();
+  const coreText = (length) => {
+    const bytes = new Uint8Array(Module.HEAPU8.buffer, Module.jsTextData(), length);
+    return textDecoder.decode(bytes.buffer instanceof ArrayBuffer ? bytes : bytes.slice());
+  };
+
+  // Drained events go to stderr; per-instruction ones (EXEC, BRANCH) only
+  // with --trace
+  const printEvents = () => {
+    const count = Module.jsDrainEvents();
+    const base = Module.jsEventsPtr();
+    for (let i = 0; i < count; i++) {
+      if (!opts.trace && Module.HEAPU8[base + i * EVENT_SIZE] <= EVENT_BRANCH) continue;
+      process.stderr.write(coreText(Module.jsFormatEvents(i, 1)));
+    }
+  };
+
+  const missing = REQUIRED_BINDINGS.filter((name) => typeof Module[name] !== "function");
+  if (missing.length) {
+    console.error(`[Error] ${opts.module} is out of date (missing ${missing.join(", ")}); rebuild it with ./build.sh`);
+    process.exit(1);
+  }
+  if (opts.profile || opts.mix !== null) Module.jsSetProfiling(true);
+  if (opts.pipeline !== null && !Module.jsSetPipeline(true, opts.pipeline)) {
+    console.error(`[Error] Bad pipeline setting: ${opts.pipeline}`);
+    process.exit(2);
+  }
+
+  // --- Load ---
+  let bytes;
+  try {
+    bytes = fs.readFileSync(opts.program);
+  } catch (e) {
+    console.error(`[Error] Cannot open ${opts.program}`);
+    process.exit(1);
+  }
+  const loadStart = performance.now();
+  if (bytes.length >= 4 && bytes[0] === 0x7f && bytes.toString("latin1", 1, 4) === "ELF") {
+    if (!Module.jsLoadElf(bytes)) process.exit(1);
+  } else if (opts.program.endsWith(".bin")) {
+    Module.jsLoadBinary(bytes, opts.base);
+  } else if (opts.cache !== null) {
+    loadProgramCached(Module, bytes.toString("utf8"), opts);
+  } else if (opts.lazy) {
+    Module.jsLoadProgramLazy(bytes.toString("utf8"));
+  } else {
+    Module.jsLoadProgram(bytes.toString("utf8"));
+  }
+  const loadMs = performance.now() - loadStart;
+  peakHeap = Math.max(peakHeap, Module.HEAPU8.length);
+
+  // --- Run ---
+  const limit = opts.max ? Module.jsInstret() + opts.max : 0;
+  let running = true;
+  const runStart = performance.now();
+  if (opts.engine === "batch") {
+    while (running && (!limit || Module.jsInstret() < limit)) {
+      const budget = limit ? Math.min(limit - Module.jsInstret(), MAX_U32) : 0;
+      running = Module.jsRunFor(SLICE_US, budget) === RUN_RUNNING;
+      peakHeap = Math.max(peakHeap, Module.HEAPU8.length);
+    }
+  } else {
+    for (let n = 1; running && (!limit || Module.jsInstret() < limit); n++) {
+      running = Module.jsStep();
+      if (n % DRAIN_INTERVAL === 0) {
+        printEvents();
+        peakHeap = Math.max(peakHeap, Module.HEAPU8.length);
+      }
+    }
+  }
+  const runSec = (performance.now() - runStart) / 1000;
+  printEvents();
+
+  // --- Report ---
+  if (!opts.quiet) process.stdout.write(coreText(Module.jsDumpState()) + "\n");
+  const instret = Module.jsInstret();
+  console.log(`engine        ${opts.engine}`);
+  console.log(`stopped       ${running ? "instruction limit" : "halted"}`);
+  console.log(`instructions  ${instret}`);
+  console.log(`instantiate   ${instantiateMs.toFixed(3)} ms`);
+  console.log(`load time     ${loadMs.toFixed(3)} ms`);
+  console.log(`run time      ${(runSec * 1000).toFixed(3)} ms`);
+  console.log(`rate          ${(runSec > 0 ? instret / runSec / 1e6 : 0).toFixed(1)} MIPS`);
+  console.log(`peak heap     ${(peakHeap / (1 << 20)).toFixed(1)} MiB`);
+  if (opts.pipeline !== null) process.stdout.write(coreText(Module.jsPipelineReport()));
+  if (opts.profile) printProfile(Module, coreText, bytes.toString("utf8"));
+  if (opts.mix === "-") process.stdout.write(mixJson(Module, coreText, instret));
+  else if (opts.mix !== null) {
+    try {
+      fs.writeFileSync(opts.mix, mixJson(Module, coreText, instret));
+    } catch (e) {
+      console.error(`[Error] Cannot write ${opts.mix}`);
+      process.exit(1);
+    }
+  }
+
+  // Exit explicitly: a -pthread build keeps its worker pool alive
+  process.exit(0);
+}
+
+main();
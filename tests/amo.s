@@ -0,0 +1,76 @@
+# A extension, word forms: each AMO returns the old value and leaves the
+# new one in memory; SC succeeds only on a live reservation.
+  la s0, word
+  li t1, 3
+  amoadd.w t0, t1, (s0)
+  li t2, 5
+  bne t0, t2, fail
+  lw t0, 0(s0)
+  li t2, 8
+  bne t0, t2, fail
+
+  # the old value is sign-extended
+  li t1, -2
+  amoswap.w t0, t1, (s0)
+  li t2, 8
+  bne t0, t2, fail
+  li t1, 4
+  amomin.w t0, t1, (s0)
+  li t2, -2
+  bne t0, t2, fail
+  lw t0, 0(s0)
+  bne t0, t2, fail
+  amomaxu.w t0, t1, (s0)
+  lw t0, 0(s0)
+  li t2, -2
+  bne t0, t2, fail
+  amomax.w t0, t1, (s0)
+  lw t0, 0(s0)
+  li t2, 4
+  bne t0, t2, fail
+  amominu.w t0, zero, (s0)
+  lw t0, 0(s0)
+  bne t0, zero, fail
+
+  li t1, 0x0ff0
+  amoor.w t0, t1, (s0)
+  li t1, 0x00ff
+  amoand.w t0, t1, (s0)
+  li t1, 0x0f
+  amoxor.w t0, t1, (s0)
+  lw t0, 0(s0)
+  li t2, 0xff
+  bne t0, t2, fail
+
+  # LR/SC: success, then SC without a reservation, then SC after the
+  # reserved word changed
+  li t1, 7
+  lr.w t0, (s0)
+  li t2, 0xff
+  bne t0, t2, fail
+  sc.w t3, t1, (s0)
+  bne t3, zero, fail
+  lw t0, 0(s0)
+  bne t0, t1, fail
+  sc.w t3, t1, (s0)
+  beq t3, zero, fail
+  lr.w t0, (s0)
+  li t2, 9
+  sw t2, 0(s0)
+  sc.w t3, t1, (s0)
+  beq t3, zero, fail
+  lw t0, 0(s0)
+  bne t0, t2, fail
+
+  # a reservation covers only its own address
+  la s1, other
+  lr.w t0, (s0)
+  sc.w t3, t1, (s1)
+  beq t3, zero, fail
+  ecall
+fail:
+  ebreak
+
+.data
+word: .word 5
+other: .word 0
@@ -0,0 +1,43 @@
+# A extension, doubleword forms: full 64-bit values, including carries
+# across the word boundary.
+# xlen: 64
+  la s0, dword
+  li t1, 1
+  amoadd.d t0, t1, (s0)
+  li t2, 0xffffffff
+  bne t0, t2, fail
+  ld t0, 0(s0)
+  li t2, 0x100000000
+  bne t0, t2, fail
+  lw t0, 4(s0)
+  li t2, 1
+  bne t0, t2, fail
+
+  li t1, -1
+  amomin.d t0, t1, (s0)
+  ld t0, 0(s0)
+  bne t0, t1, fail
+  amomaxu.d t0, zero, (s0)
+  ld t0, 0(s0)
+  bne t0, t1, fail
+  li t1, 0x123456789
+  amoswap.d t0, t1, (s0)
+  li t2, -1
+  bne t0, t2, fail
+
+  lr.d t0, (s0)
+  bne t0, t1, fail
+  li t2, 0x7000000000
+  sc.d t3, t2, (s0)
+  bne t3, zero, fail
+  ld t0, 0(s0)
+  bne t0, t2, fail
+  sc.d t3, t2, (s0)
+  beq t3, zero, fail
+  ecall
+fail:
+  ebreak
+
+.data
+.align 3
+dword: .dword 0xffffffff
@@ -0,0 +1,34 @@
+// State deltas of atomics: an AMO or SC marks every word it writes (both
+// words of a doubleword), while LR only reads and marks nothing.
+#include "riscv_core.h"
+#include "check.h"
+
+// Word ranges written by `program` after it loads, as (first, count) pairs
+static vector<uint32_t> writtenRanges(const char *program)
+{
+    SimpleRISCV cpu;
+    cpu.loadProgram(program);
+    cpu.consumeDelta();
+    while (cpu.step())
+        ;
+    const vector<uint32_t> &delta = cpu.consumeDelta();
+    CHECK(!(delta[0] & SimpleRISCV::DELTA_FULL));
+    return vector<uint32_t>(delta.begin() + 3, delta.end());
+}
+
+int main()
+{
+    const vector<uint32_t> word = {0x800 / 4, 1}, dword = {0x800 / 4, 2};
+    CHECK(writtenRanges("li t0, 0x800\nli t1, -1\namoswap.w t2, t1, (t0)\necall\n") == word);
+    CHECK(writtenRanges("li t0, 0x800\nlr.w t2, (t0)\necall\n").empty());
+    CHECK(writtenRanges("li t0, 0x800\nli t1, 5\nlr.w t2, (t0)\nsc.w t3, t1, (t0)\necall\n") == word);
+#if RISCV_XLEN == 64
+    CHECK(writtenRanges("li t0, 0x800\nli t1, -1\namoswap.d t2, t1, (t0)\necall\n") == dword);
+    CHECK(writtenRanges("li t0, 0x800\nli t1, 1\namoadd.d t2, t1, (t0)\necall\n") == dword);
+    CHECK(writtenRanges("li t0, 0x800\nlr.d t2, (t0)\necall\n").empty());
+    CHECK(writtenRanges("li t0, 0x800\nli t1, 5\nlr.d t2, (t0)\nsc.d t3, t1, (t0)\necall\n") == dword);
+#else
+    (void)dword;
+#endif
+    return checkResult();
+}
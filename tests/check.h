@@ -0,0 +1,20 @@
+// Assertions for the tests/*.cpp programs: a failed CHECK prints the
+// condition and its line, and checkResult() turns any failure into a
+// non-zero exit status.
+#pragma once
+
+#include <cstdio>
+
+static int checkFailures = 0;
+
+#define CHECK(cond)                                                             \
+    do                                                                          \
+    {                                                                           \
+        if (!(cond))                                                            \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++checkFailures;                                                    \
+        }                                                                       \
+    } while (0)
+
+static int checkResult() { return checkFailures ? 1 : 0; }
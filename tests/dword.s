@@ -0,0 +1,29 @@
+# .dword/.quad keep all 64 bits of a constant, on RV32 as well as RV64
+  la t0, values
+  lw t1, 0(t0)          # .dword 0x100000002: low word, then high word
+  li t2, 2
+  bne t1, t2, fail
+  lw t1, 4(t0)
+  li t2, 1
+  bne t1, t2, fail
+  lw t1, 8(t0)          # .quad 0x7654321012345678
+  li t2, 0x12345678
+  bne t1, t2, fail
+  lw t1, 12(t0)
+  li t2, 0x76543210
+  bne t1, t2, fail
+  lw t1, 16(t0)         # .dword -2
+  li t2, -2
+  bne t1, t2, fail
+  lw t1, 20(t0)
+  li t2, -1
+  bne t1, t2, fail
+  ecall
+fail:
+  ebreak
+
+.data
+values:
+  .dword 0x100000002
+  .quad 0x7654321012345678
+  .dword -2
@@ -0,0 +1,125 @@
+// ELF loading: a statically linked executable of this XLEN, built here
+// from assembled code, loads its segment (with .bss), entry point, gp and
+// symbols and runs; images of the wrong class, type or size are refused.
+#include "riscv_core.h"
+#include "check.h"
+
+using Elf = ElfTypes<RISCV_XLEN>;
+
+static const char PROGRAM[] = R"(main:
+    la   a1, value
+    lw   a0, 0(a1)
+    jal  ra, helper
+    lw   a2, 4(a1)
+    ecall
+helper:
+    addi a0, a0, 10
+    ret
+.data
+value: .word 32
+)";
+
+static const uint64_t BASE = 0x10000, BSS = 64;
+
+// Ehdr, one PT_LOAD, the segment bytes, then .strtab, .symtab and the
+// section headers (null, .symtab, .strtab)
+static vector<uint8_t> buildElf(const SimpleRISCV &code)
+{
+    const char names[] = "\0main\0helper\0__global_pointer$";
+    vector<uint8_t> out(sizeof(Elf::Ehdr) + sizeof(Elf::Phdr));
+    auto append = [&out](const void *p, size_t n)
+    {
+        size_t at = out.size();
+        out.insert(out.end(), static_cast<const uint8_t *>(p), static_cast<const uint8_t *>(p) + n);
+        return at;
+    };
+
+    size_t segment = append(code.image.data(), code.image.size());
+    size_t strtab = append(names, sizeof(names));
+    Elf::Sym syms[4] = {};
+    const uint64_t values[] = {(uint64_t)code.labels.at("main"), (uint64_t)code.labels.at("helper"), BASE + 0x800};
+    const uint32_t offsets[] = {1, 6, 13};
+    for (int i = 0; i < 3; ++i)
+    {
+        syms[i + 1].name = offsets[i];
+        syms[i + 1].value = values[i];
+        if (i < 2)
+            syms[i + 1].info = ELF_STT_FUNC;
+        syms[i + 1].shndx = 1;
+    }
+    size_t symtab = append(syms, sizeof(syms));
+
+    Elf::Shdr sh[3] = {};
+    sh[1].type = ELF_SHT_SYMTAB;
+    sh[1].offset = symtab;
+    sh[1].size = sizeof(syms);
+    sh[1].link = 2;
+    sh[2].type = 3; // SHT_STRTAB
+    sh[2].offset = strtab;
+    sh[2].size = sizeof(names);
+    size_t shoff = append(sh, sizeof(sh));
+
+    Elf::Ehdr eh = {};
+    memcpy(eh.ident, "\x7f" "ELF", 4);
+    eh.ident[4] = Elf::ELF_CLASS;
+    eh.ident[5] = 1;
+    eh.type = ELF_ET_EXEC;
+    eh.machine = ELF_EM_RISCV;
+    eh.entry = code.textBase;
+    eh.phoff = sizeof(Elf::Ehdr);
+    eh.shoff = shoff;
+    eh.phentsize = sizeof(Elf::Phdr);
+    eh.phnum = 1;
+    eh.shentsize = sizeof(Elf::Shdr);
+    eh.shnum = 3;
+    memcpy(out.data(), &eh, sizeof(eh));
+
+    Elf::Phdr ph = {};
+    ph.type = ELF_PT_LOAD;
+    ph.offset = segment;
+    ph.vaddr = ph.paddr = code.imageBase;
+    ph.filesz = code.image.size();
+    ph.memsz = code.image.size() + BSS;
+    memcpy(out.data() + eh.phoff, &ph, sizeof(ph));
+    return out;
+}
+
+int main()
+{
+    SimpleRISCV code;
+    code.loadProgram(PROGRAM, BASE);
+    const vector<uint8_t> elf = buildElf(code);
+
+    SimpleRISCV cpu;
+    CHECK(cpu.loadElf(elf.data(), elf.size()));
+    CHECK(cpu.regs.pc == (SimpleRISCV::sreg)BASE);
+    CHECK(cpu.regs.x[3] == (SimpleRISCV::sreg)(BASE + 0x800));
+    CHECK(cpu.regs.x[2] == (SimpleRISCV::sreg)cpu.memory.size());
+    CHECK(equal(code.image.begin(), code.image.end(), cpu.memory.begin() + BASE));
+    CHECK(cpu.symbols.size() == 3);
+    CHECK(cpu.getSymbolForPC(code.labels.at("helper") + 4) == "helper");
+    while (cpu.step())
+        ;
+    CHECK(cpu.regs.x[10] == 42);
+    CHECK(cpu.regs.x[12] == 0); // first .bss word
+
+    auto refused = [](vector<uint8_t> bad)
+    {
+        SimpleRISCV other;
+        return !other.loadElf(bad.data(), bad.size());
+    };
+    vector<uint8_t> bad = elf;
+    bad[4] = 3 - Elf::ELF_CLASS;
+    CHECK(refused(bad));
+    bad = elf;
+    bad[16] = 3; // ET_DYN
+    CHECK(refused(bad));
+    CHECK(refused(vector<uint8_t>(elf.begin(), elf.begin() + sizeof(Elf::Ehdr) + 4)));
+    bad = elf;
+    Elf::Phdr ph;
+    memcpy(&ph, bad.data() + sizeof(Elf::Ehdr), sizeof(ph));
+    ph.memsz = SimpleRISCV::MAX_GUEST_MEMORY;
+    memcpy(bad.data() + sizeof(Elf::Ehdr), &ph, sizeof(ph));
+    CHECK(refused(bad));
+    return checkResult();
+}
@@ -0,0 +1,61 @@
+// Lazy assembly must run a program exactly like eager assembly: same
+// registers, memory, labels and instruction count. The program reads all
+// of its own code as data, so every pending word is assembled by a load.
+#include "riscv_core.h"
+#include "check.h"
+
+static const char PROGRAM[] = R"(main:
+    la   s0, table
+    li   s1, 0
+    li   t0, 0
+loop:
+    slli t1, t0, 2
+    add  t1, t1, s0
+    lw   t2, 0(t1)
+    add  s1, s1, t2
+    addi t0, t0, 1
+    li   t3, 4
+    blt  t0, t3, loop
+    jal  ra, square
+    li   a1, 0x12345678
+    la   t0, main
+    la   t1, end
+    li   a2, 0
+sum:
+    lw   t2, 0(t0)
+    xor  a2, a2, t2
+    addi t0, t0, 4
+    blt  t0, t1, sum
+    ecall
+square:
+    mul  a0, s1, s1
+    ret
+unused:
+    ebreak
+end:
+.data
+table: .word 1, 2, 3, 4
+ptrs: .word loop, square, unused
+)";
+
+int main()
+{
+    SimpleRISCV eager, lazy;
+    eager.loadProgram(PROGRAM);
+    lazy.lazyAssembly = true;
+    lazy.loadProgram(PROGRAM);
+    CHECK(lazy.pendingStatements > 0);
+    CHECK(lazy.labels == eager.labels);
+    CHECK(lazy.sourceLines == eager.sourceLines);
+
+    while (eager.step())
+        ;
+    while (lazy.step())
+        ;
+    CHECK(lazy.pendingStatements == 0);
+    CHECK(memcmp(&lazy.regs, &eager.regs, sizeof(eager.regs)) == 0);
+    CHECK(lazy.memory == eager.memory);
+    CHECK(lazy.instret == eager.instret);
+    CHECK(eager.regs.x[10] == 100 && eager.regs.x[11] == 0x12345678);
+    return checkResult();
+}
@@ -0,0 +1,20 @@
+# riscv-run: --mix=-
+# Instruction mix of a loop that loads, stores, branches and makes an
+# atomic update: classes first, then each opcode that ran
+  la s0, buffer
+  li t0, 0
+  li t1, 8
+loop:
+  lw t2, 0(s0)
+  addi t2, t2, 3
+  sw t2, 0(s0)
+  amoadd.w zero, t1, (s0)
+  addi t0, t0, 1
+  blt t0, t1, loop
+  jal ra, done
+  ebreak
+done:
+  ecall
+
+.data
+buffer: .word 0
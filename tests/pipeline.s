@@ -0,0 +1,18 @@
+# riscv-run: --pipeline
+# One of each hazard under the default timing. The first instruction
+# writes back in cycle 5 and each later one adds a cycle, plus: the add
+# waits 1 for the loaded value (data), the mul holds EX for 2 more
+# (structural), the taken branch costs 2 and the jal 1 (control), so 8
+# instructions take 18 cycles.
+  li t0, 1024
+  lw t1, 0(t0)
+  add t2, t1, t1
+  mul t3, t2, t2
+  addi t4, t3, 1
+  beq zero, zero, skip
+  ebreak
+skip:
+  jal ra, end
+  ebreak
+end:
+  ecall
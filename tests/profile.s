@@ -0,0 +1,18 @@
+# riscv-run: --profile
+# Execution counts per function and the hottest lines: 1000 calls to work,
+# each 50 times round its inner loop
+main:
+  li s0, 0
+  li s1, 1000
+outer:
+  jal ra, work
+  addi s0, s0, 1
+  blt s0, s1, outer
+  ecall
+work:
+  li t0, 0
+  li t1, 50
+inner:
+  addi t0, t0, 1
+  blt t0, t1, inner
+  ret
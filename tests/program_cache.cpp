@@ -0,0 +1,105 @@
+// Program cache: a saved program restores to the same state as assembling
+// it; a blob that does not match the source, is cut short or describes an
+// inconsistent image is rejected and leaves the core untouched; the
+// on-disk cache misses, hits, and falls back when its entry is damaged.
+#include "riscv_core.h"
+#include "check.h"
+
+using Header = SimpleRISCV::CacheHeader;
+
+static const char PROGRAM[] = R"(main:
+    la   s0, table
+    lw   a0, 4(s0)
+    jal  ra, twice
+    ecall
+twice:
+    add  a0, a0, a0
+    ret
+.data
+table: .word 7, 21, main
+)";
+
+static const char OTHER[] = "start:\n    li a0, 1\n    ecall\n";
+
+static bool sameState(const SimpleRISCV &a, const SimpleRISCV &b)
+{
+    return a.memory == b.memory && a.image == b.image && a.labels == b.labels &&
+           a.sourceLines == b.sourceLines && a.textBase == b.textBase && a.dataBase == b.dataBase &&
+           memcmp(&a.regs, &b.regs, sizeof(a.regs)) == 0;
+}
+
+// `blob` with its header edited by `edit`
+template <class F>
+static vector<uint8_t> withHeader(vector<uint8_t> blob, F edit)
+{
+    Header h;
+    memcpy(&h, blob.data(), sizeof(h));
+    edit(h);
+    memcpy(blob.data(), &h, sizeof(h));
+    return blob;
+}
+
+int main()
+{
+    const uint64_t key = SimpleRISCV::programCacheKey(PROGRAM);
+    SimpleRISCV assembled;
+    assembled.loadProgram(PROGRAM);
+    vector<uint8_t> blob;
+    CHECK(assembled.saveProgramCache(key, blob));
+
+    // Round trip, then both run alike
+    SimpleRISCV restored;
+    CHECK(restored.loadProgramCache(blob.data(), blob.size(), PROGRAM, key));
+    CHECK(sameState(restored, assembled));
+    while (assembled.step())
+        ;
+    while (restored.step())
+        ;
+    CHECK(restored.regs.x[10] == 42);
+    CHECK(memcmp(&restored.regs, &assembled.regs, sizeof(restored.regs)) == 0);
+
+    // Rejected blobs change nothing
+    SimpleRISCV target, before;
+    target.loadProgram(OTHER);
+    before.loadProgram(OTHER);
+    auto rejected = [&](const vector<uint8_t> &bad, uint64_t k = 0)
+    {
+        bool loaded = target.loadProgramCache(bad.data(), bad.size(), PROGRAM, k ? k : key);
+        return !loaded && sameState(target, before);
+    };
+    CHECK(rejected(blob, key + 1));
+    for (size_t size = 0; size < blob.size(); size += 3)
+        CHECK(rejected(vector<uint8_t>(blob.begin(), blob.begin() + size)));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.magic[0] = 'X'; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.imageSize -= 4; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.sectionSize[SECTION_DATA] += 64; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.wordCount += 1; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.imageBase = -4; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.textBase = h.imageBase = -0x1000; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.textBase += 2; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.dataBase = numeric_limits<int64_t>::max() - 8; })));
+    CHECK(rejected(withHeader(blob, [](Header &h) { h.labelCount += 1; })));
+
+    // On disk: miss, hit, then a damaged entry falls back to assembling
+    char dir[] = "/tmp/riscv-cache-test-XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.rvpc", (unsigned long long)key);
+    const string path = string(dir) + name;
+
+    SimpleRISCV disk;
+    CHECK(!disk.loadProgramCached(PROGRAM, dir));
+    CHECK(disk.loadProgramCached(PROGRAM, dir));
+    SimpleRISCV fresh;
+    fresh.loadProgram(PROGRAM);
+    CHECK(sameState(disk, fresh));
+
+    CHECK(truncate(path.c_str(), sizeof(Header) + 8) == 0);
+    CHECK(!disk.loadProgramCached(PROGRAM, dir));
+    CHECK(sameState(disk, fresh));
+    CHECK(disk.loadProgramCached(PROGRAM, dir)); // rewritten by the fallback
+
+    unlink(path.c_str());
+    rmdir(dir);
+    return checkResult();
+}
@@ -0,0 +1,16 @@
+# riscv-run: --pipeline
+# rdcycle reads the pipeline model's cycle count. With the default settings
+# the first instruction writes back in cycle 5, each ALU op after it takes
+# one cycle and DIV holds EX for 20, so the second read sees 27 (instret
+# would give 4).
+  rdcycle t0
+  li t1, 100
+  li t2, 7
+  div t3, t1, t2
+  rdcycle t4
+  sub t5, t4, t0
+  li t6, 27
+  bne t5, t6, fail
+  ecall
+fail:
+  ebreak
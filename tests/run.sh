@@ -0,0 +1,58 @@
+#!/bin/sh
+# Builds riscv-run for RV32 and RV64 and runs every test on both.
+#
+# tests/*.s pass when they halt on ECALL and fail on EBREAK (or any other
+# stop). Extra riscv-run options go on a "# riscv-run: ..." line, and an
+# "# xlen: 64" line limits a test to one XLEN. A test with a .expected
+# file is run with --quiet and passes when its output, less the timing
+# lines, matches that file instead.
+#
+# tests/*.cpp are built against riscv_core.h for each XLEN and pass when
+# they exit with status 0.
+cd "$(dirname "$0")/.." || exit 1
+out=${TMPDIR:-/tmp}/riscv-tests
+mkdir -p "$out"
+g++ -std=c++20 -O2 riscv_run.cpp -o "$out/riscv-run32" || exit 1
+g++ -std=c++20 -O2 -DRISCV_XLEN=64 riscv_run.cpp -o "$out/riscv-run64" || exit 1
+
+failed=0
+result() {
+  if [ "$1" -eq 0 ]; then
+    echo "PASS  rv$xlen  $test"
+  else
+    echo "FAIL  rv$xlen  $test"
+    failed=$((failed + 1))
+  fi
+}
+
+for test in tests/*.s; do
+  opts=$(sed -n 's/^# riscv-run: //p' "$test")
+  xlens=$(sed -n 's/^# xlen: //p' "$test")
+  expected=${test%.s}.expected
+  for xlen in ${xlens:-32 64}; do
+    if [ -f "$expected" ]; then
+      "$out/riscv-run$xlen" --quiet --max=10000000 $opts "$test" 2>&1 |
+        grep -Ev '^(load time|run time|rate) ' | diff -u "$expected" - >"$out/diff"
+      status=$?
+      [ $status -eq 0 ] || cat "$out/diff"
+      result $status
+    else
+      "$out/riscv-run$xlen" --quiet --max=10000000 $opts "$test" 2>&1 | grep -q "ECALL — program halted"
+      result $?
+    fi
+  done
+done
+
+for test in tests/*.cpp; do
+  name=$(basename "$test" .cpp)
+  for xlen in 32 64; do
+    if g++ -std=c++20 -O1 -I. -DRISCV_XLEN=$xlen "$test" -o "$out/$name$xlen" &&
+      "$out/$name$xlen" >"$out/log" 2>&1; then
+      result 0
+    else
+      grep -v '^\[' "$out/log"
+      result 1
+    fi
+  done
+done
+exit $((failed > 0))
@@ -0,0 +1,89 @@
+// updateLines() must leave the same program as assembling the edited
+// source from scratch, whether the edit moves labels, resizes statements,
+// touches .data or switches sections.
+#include "riscv_core.h"
+#include "check.h"
+
+static string join(const vector<string> &lines)
+{
+    string text;
+    for (const auto &line : lines)
+        text += line + "\n";
+    return text;
+}
+
+static void expectSameProgram(SimpleRISCV &updated, const vector<string> &lines, int edit)
+{
+    SimpleRISCV full;
+    full.loadProgram(join(lines));
+    if (updated.image != full.image || updated.memory != full.memory || updated.labels != full.labels ||
+        updated.sourceLines != full.sourceLines || updated.textBase != full.textBase ||
+        updated.dataBase != full.dataBase)
+        fprintf(stderr, "edit %d: program differs from a full assembly\n", edit);
+    CHECK(updated.image == full.image);
+    CHECK(updated.memory == full.memory);
+    CHECK(updated.labels == full.labels);
+    CHECK(updated.sourceLines == full.sourceLines);
+    CHECK(updated.dataBase == full.dataBase);
+
+    for (int i = 0; i < 100000 && updated.step(); ++i)
+        ;
+    for (int i = 0; i < 100000 && full.step(); ++i)
+        ;
+    CHECK(memcmp(&updated.regs, &full.regs, sizeof(full.regs)) == 0);
+    CHECK(updated.instret == full.instret);
+}
+
+int main()
+{
+    vector<string> lines = {
+        "main:",
+        "    la   s0, table",
+        "    li   s1, 0",
+        "    li   t0, 0",
+        "loop:",
+        "    slli t1, t0, 2",
+        "    add  t1, t1, s0",
+        "    lw   t2, 0(t1)",
+        "    add  s1, s1, t2",
+        "    addi t0, t0, 1",
+        "    li   t3, 4",
+        "    blt  t0, t3, loop",
+        "    jal  ra, done",
+        "    ebreak",
+        "done:",
+        "    ecall",
+        ".data",
+        "table: .word 1, 2, 3, 4",
+        "ptr: .word loop, done",
+    };
+    SimpleRISCV updated;
+    updated.loadProgram(join(lines));
+
+    // (first line, lines removed, new lines)
+    struct Edit
+    {
+        size_t first, removed;
+        vector<string> text;
+    };
+    const Edit edits[] = {
+        {8, 0, {"    addi s1, s1, 1"}},                       // moves every later label
+        {2, 1, {"    li   s1, 0x12345"}},                     // LI grows to two words
+        {8, 1, {}},                                           // and the first edit undone
+        {17, 1, {"table: .word 5, 6, 7, 8"}},                 // data only
+        {4, 0, {"again:"}},                                   // a second label, same address
+        {19, 1, {"ptr: .word again, done", "extra: .word table"}}, // new .data label
+        {14, 1, {".data", "spill: .word 9", ".text"}},        // section switches
+        {99, 0, {"last: .word 3"}},                           // appended
+    };
+    int n = 0;
+    for (const Edit &e : edits)
+    {
+        updated.updateLines(e.first, e.removed, join(e.text));
+        size_t first = min(e.first, lines.size());
+        lines.erase(lines.begin() + first, lines.begin() + first + e.removed);
+        lines.insert(lines.begin() + first, e.text.begin(), e.text.end());
+        expectSameProgram(updated, lines, ++n);
+    }
+    return checkResult();
+}